@@ -0,0 +1,33 @@
+; Benchmark: call-heavy code. 50000 iterations of a three-level call chain
+; (outer -> middle -> leaf twice) plus a direct leaf call, with arguments
+; saved on the stack. Prints the 16-bit accumulator: 50000 * 7 mod 65536 = 22320.
+
+.org 0x0000
+start:
+    LDI  r0, 0              ; accumulator
+    LDI  r4, 50000
+loop:
+    CALL outer              ; r0 += 5
+    CALL leaf2              ; r0 += 2
+    SUBI r4, 1
+    JNZ  loop
+    ST   r0, [0xFF12]
+    HALT
+
+outer:
+    PUSH r4
+    CALL middle             ; r0 += 4
+    CALL leaf1              ; r0 += 1
+    POP  r4
+    RET
+middle:
+    PUSH r4
+    CALL leaf2
+    CALL leaf2
+    POP  r4
+    RET
+leaf2:
+    CALL leaf1
+leaf1:
+    ADDI r0, 1
+    RET
@@ -0,0 +1,28 @@
+; Benchmark: deep recursion. Recursive fib(24) = 46368, ~150K calls.
+; Prints 46368.
+
+.org 0x0000
+start:
+    LDI  r0, 24
+    CALL fib
+    ST   r0, [0xFF12]
+    HALT
+
+; fib(n): r0 = n, returns fib(n) in r0; clobbers r1
+fib:
+    LDI  r1, 2
+    CMP  r0, r1
+    JC   fib_small          ; n < 2: fib(n) = n
+    PUSH r0
+    SUBI r0, 1
+    CALL fib                ; r0 = fib(n-1)
+    POP  r1                 ; r1 = n
+    PUSH r0
+    MOV  r0, r1
+    SUBI r0, 2
+    CALL fib                ; r0 = fib(n-2)
+    POP  r1
+    ADD  r0, r1
+    RET
+fib_small:
+    RET
@@ -0,0 +1,34 @@
+; Benchmark: memory loops. 64 passes over a 4096-word buffer at 0x4000:
+; fill buf[i] = i + pass with ST [r], then sum it back with LD [r].
+; Prints the 16-bit sum of the last pass (pass 63): 59392.
+
+.org 0x0000
+start:
+    LDI  r4, 0              ; pass
+pass:
+    ; fill
+    LDI  r1, 0x4000         ; p
+    LDI  r2, 4096           ; n
+    MOV  r3, r4             ; value = pass
+fill:
+    ST   r3, [r1]
+    ADDI r3, 1
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  fill
+    ; sum
+    LDI  r1, 0x4000
+    LDI  r2, 4096
+    LDI  r0, 0
+sum:
+    LD   r3, [r1]
+    ADD  r0, r3
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  sum
+    ADDI r4, 1
+    LDI  r5, 64
+    CMP  r4, r5
+    JNZ  pass
+    ST   r0, [0xFF12]
+    HALT
@@ -0,0 +1,21 @@
+; Benchmark: MMIO-heavy output. 20000 iterations, each printing a
+; 13-character string through TX_STR, one TX_CHAR and one TX_INT.
+; The last line printed is "emu16 bench, *19999".
+
+.org 0x0000
+start:
+    LDI  r4, 0              ; i
+    LDI  r5, 20000
+loop:
+    LDI  r1, msg
+    ST   r1, [0xFF10]       ; TX_STR
+    LDI  r1, '*'
+    ST   r1, [0xFF00]       ; TX_CHAR
+    ST   r4, [0xFF12]       ; TX_INT i
+    ADDI r4, 1
+    CMP  r4, r5
+    JNZ  loop
+    HALT
+
+msg:
+    .asciiz "emu16 bench, "
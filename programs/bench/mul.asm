@@ -0,0 +1,33 @@
+; Benchmark: MUL-heavy arithmetic. 400000 steps of the LCG
+; x = x * 25173 + 13849 (mod 2^16), each also folding x*x into a checksum
+; with a Horner step c = c * 31 + x*x. Prints x, then the checksum.
+
+.org 0x0000
+start:
+    LDI  r0, 1              ; x
+    LDI  r1, 0              ; checksum c
+    LDI  r2, 25173
+    LDI  r3, 31
+    LDI  r6, 4              ; 4 passes
+pass:
+    LDI  r4, 50000          ; of 2 x 50000 steps
+loop:
+    MUL  r0, r2
+    ADDI r0, 13849
+    MOV  r5, r0
+    MUL  r5, r0
+    MUL  r1, r3
+    ADD  r1, r5
+    MUL  r0, r2
+    ADDI r0, 13849
+    MOV  r5, r0
+    MUL  r5, r0
+    MUL  r1, r3
+    ADD  r1, r5
+    SUBI r4, 1
+    JNZ  loop
+    SUBI r6, 1
+    JNZ  pass
+    ST   r0, [0xFF12]
+    ST   r1, [0xFF12]
+    HALT
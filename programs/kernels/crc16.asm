@@ -0,0 +1,74 @@
+; Kernel: CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, MSB first), bitwise.
+; Data is one byte per word. Checks the standard "123456789" vector, then
+; checksums a 2048-byte pseudo-random buffer at 0x4000 (high byte of the LCG
+; x = x * 25173 + 13849, seed 3) four times, feeding each CRC into the next
+; run's first byte. Prints:
+;   10673
+;   63180
+
+.org 0x0000
+start:
+    LDI  r1, check_str
+    LDI  r2, 9
+    CALL crc16
+    ST   r0, [0xFF12]       ; 0x29B1
+
+    LDI  r1, 0x4000
+    LDI  r2, 2048
+    LDI  r0, 3              ; x
+    LDI  r3, 25173
+    LDI  r5, 8
+gen:
+    MUL  r0, r3
+    ADDI r0, 13849
+    MOV  r4, r0
+    SHR  r4, r5
+    ST   r4, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  gen
+
+    LDI  r3, 4
+    LDI  r0, 0
+again:
+    LDI  r4, 0x00FF
+    AND  r0, r4
+    ST   r0, [0x4000]       ; previous CRC's low byte seeds the buffer
+    PUSH r3
+    LDI  r1, 0x4000
+    LDI  r2, 2048
+    CALL crc16
+    POP  r3
+    SUBI r3, 1
+    JNZ  again
+    ST   r0, [0xFF12]
+    HALT
+
+; crc16(r1 = bytes, r2 = count > 0) -> r0; clobbers r1..r6
+crc16:
+    LDI  r0, 0xFFFF
+    LDI  r5, 8
+    LDI  r6, 0x1021
+crc_byte:
+    LD   r3, [r1]
+    SHL  r3, r5
+    XOR  r0, r3             ; crc ^= byte << 8
+    LDI  r4, 8
+crc_bit:
+    ADD  r0, r0             ; crc <<= 1, C = old bit 15
+    JC   crc_poly
+    SUBI r4, 1
+    JNZ  crc_bit
+    JMP  crc_next
+crc_poly:
+    XOR  r0, r6
+    SUBI r4, 1
+    JNZ  crc_bit
+crc_next:
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  crc_byte
+    RET
+
+check_str:
+    .asciiz "123456789"
@@ -0,0 +1,124 @@
+; Kernel: bytecode interpreter. A stack VM with a jump-table dispatch
+; (handler address pushed and RET'd to) runs the bytecode below: the sum of
+; i * i for i = 1..2000 (mod 2^16) with a do-while loop, then 8! with a
+; while loop. VM stack at 0x5000 growing up, locals at 0x5100. Prints:
+;   41080
+;   40320
+;
+; Opcodes (operands follow inline):
+;   0 HALT   1 PUSH imm   2 ADD   3 SUB   4 MUL   5 LOAD n   6 STORE n
+;   7 JNZ addr (pops)   8 PRINT (pops)   9 DUP   10 JMP addr
+
+.org 0x0000
+start:
+    LDI  r1, bytecode       ; VM pc
+    LDI  r2, 0x5000         ; VM sp (next free slot)
+dispatch:
+    LD   r0, [r1]
+    ADDI r1, 1
+    LDI  r3, handlers
+    ADD  r3, r0
+    LD   r3, [r3]
+    PUSH r3
+    RET
+
+op_halt:
+    HALT
+op_push:
+    LD   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r2]
+    ADDI r2, 1
+    JMP  dispatch
+op_add:
+    SUBI r2, 1
+    LD   r5, [r2]
+    SUBI r2, 1
+    LD   r4, [r2]
+    ADD  r4, r5
+    ST   r4, [r2]
+    ADDI r2, 1
+    JMP  dispatch
+op_sub:
+    SUBI r2, 1
+    LD   r5, [r2]
+    SUBI r2, 1
+    LD   r4, [r2]
+    SUB  r4, r5
+    ST   r4, [r2]
+    ADDI r2, 1
+    JMP  dispatch
+op_mul:
+    SUBI r2, 1
+    LD   r5, [r2]
+    SUBI r2, 1
+    LD   r4, [r2]
+    MUL  r4, r5
+    ST   r4, [r2]
+    ADDI r2, 1
+    JMP  dispatch
+op_load:
+    LD   r4, [r1]
+    ADDI r1, 1
+    ADDI r4, 0x5100
+    LD   r4, [r4]
+    ST   r4, [r2]
+    ADDI r2, 1
+    JMP  dispatch
+op_store:
+    LD   r4, [r1]
+    ADDI r1, 1
+    ADDI r4, 0x5100
+    SUBI r2, 1
+    LD   r5, [r2]
+    ST   r5, [r4]
+    JMP  dispatch
+op_jnz:
+    LD   r4, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    LD   r5, [r2]
+    JZ   dispatch
+    MOV  r1, r4
+    JMP  dispatch
+op_print:
+    SUBI r2, 1
+    LD   r5, [r2]
+    ST   r5, [0xFF12]
+    JMP  dispatch
+op_dup:
+    MOV  r4, r2
+    SUBI r4, 1
+    LD   r5, [r4]
+    ST   r5, [r2]
+    ADDI r2, 1
+    JMP  dispatch
+op_jmp:
+    LD   r1, [r1]
+    JMP  dispatch
+
+handlers:
+    .word op_halt, op_push, op_add, op_sub, op_mul, op_load, op_store
+    .word op_jnz, op_print, op_dup, op_jmp
+
+bytecode:
+    .word 1, 0, 6, 0                ; s = 0
+    .word 1, 2000, 6, 1             ; i = 2000
+sq_loop:
+    .word 5, 1, 9, 4                ; i * i
+    .word 5, 0, 2, 6, 0             ; s += i * i
+    .word 5, 1, 1, 1, 3, 9, 6, 1    ; i = i - 1 (keep a copy)
+    .word 7, sq_loop                ; while i != 0
+    .word 5, 0, 8                   ; print s
+    .word 1, 1, 6, 0                ; f = 1
+    .word 1, 8, 6, 1                ; n = 8
+fact_test:
+    .word 5, 1, 7, fact_body        ; if n != 0: body
+    .word 10, fact_done
+fact_body:
+    .word 5, 0, 5, 1, 4, 6, 0       ; f *= n
+    .word 5, 1, 1, 1, 3, 6, 1       ; n -= 1
+    .word 10, fact_test
+fact_done:
+    .word 5, 0, 8                   ; print f
+    .word 0
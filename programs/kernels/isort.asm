@@ -0,0 +1,75 @@
+; Kernel: insertion sort of 256 pseudo-random words at 0x4000 (LCG
+; x = x * 25173 + 13849, seed 1), unsigned ascending. Prints the weighted
+; checksum sum(a[i] * (i + 1)) mod 2^16 and 1 if the array is sorted:
+;   26594
+;   1
+
+.org 0x0000
+start:
+    LDI  r1, 0x4000
+    LDI  r2, 256
+    LDI  r0, 1              ; x
+    LDI  r3, 25173
+gen:
+    MUL  r0, r3
+    ADDI r0, 13849
+    ST   r0, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  gen
+
+    LDI  r2, 1              ; i
+next_i:
+    LDI  r5, 0x4000
+    ADD  r5, r2             ; p = &a[i]
+    LD   r3, [r5]           ; key
+shift_loop:
+    LDI  r0, 0x4000
+    CMP  r0, r5
+    JZ   place              ; reached a[0]
+    MOV  r6, r5
+    SUBI r6, 1
+    LD   r0, [r6]           ; a[j - 1]
+    CMP  r3, r0
+    JC   shift              ; key < a[j - 1]
+    JMP  place
+shift:
+    ST   r0, [r5]           ; a[j] = a[j - 1]
+    MOV  r5, r6
+    JMP  shift_loop
+place:
+    ST   r3, [r5]
+    ADDI r2, 1
+    LDI  r0, 256
+    CMP  r2, r0
+    JNZ  next_i
+
+    LDI  r1, 0x4000
+    LDI  r2, 256
+    CALL check
+    HALT
+
+; check(r1 = array, r2 = n > 0): prints sum(a[i] * (i + 1)) and a sorted flag
+check:
+    LDI  r0, 0              ; checksum
+    LDI  r4, 1              ; weight
+    LDI  r6, 1              ; sorted
+    LDI  r3, 0              ; previous element
+check_loop:
+    LD   r5, [r1]
+    CMP  r5, r3
+    JC   check_unsorted     ; a[i] < a[i - 1]
+    JMP  check_sum
+check_unsorted:
+    LDI  r6, 0
+check_sum:
+    MOV  r3, r5
+    MUL  r5, r4
+    ADD  r0, r5
+    ADDI r4, 1
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  check_loop
+    ST   r0, [0xFF12]
+    ST   r6, [0xFF12]
+    RET
@@ -0,0 +1,73 @@
+; Kernel: 32x32 integer matrix multiply C = A * B (mod 2^16) with MUL.
+; A at 0x4000, B at 0x4400 and C at 0x4800, row-major; A and B hold the high
+; bytes of the LCG x = x * 25173 + 13849 (seed 5, A first). Prints the trace
+; of C and the sum of all its elements:
+;   11796
+;   8840
+
+.org 0x0000
+start:
+    LDI  r1, 0x4000
+    LDI  r2, 2048
+    LDI  r0, 5              ; x
+    LDI  r3, 25173
+    LDI  r5, 8
+gen:
+    MUL  r0, r3
+    ADDI r0, 13849
+    MOV  r4, r0
+    SHR  r4, r5
+    ST   r4, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  gen
+
+    LDI  r4, 0x4800         ; &C[i][j]; i and j are recovered from it
+cell:
+    MOV  r1, r4
+    SUBI r1, 0x0800
+    LDI  r6, 0xFFE0
+    AND  r1, r6             ; &A[i][0]
+    MOV  r2, r4
+    LDI  r6, 0x001F
+    AND  r2, r6
+    ADDI r2, 0x4400         ; &B[0][j]
+    LDI  r0, 0
+    LDI  r3, 32
+dot:
+    LD   r5, [r1]
+    LD   r6, [r2]
+    MUL  r5, r6
+    ADD  r0, r5
+    ADDI r1, 1
+    ADDI r2, 32
+    SUBI r3, 1
+    JNZ  dot
+    ST   r0, [r4]
+    ADDI r4, 1
+    LDI  r6, 0x4C00
+    CMP  r4, r6
+    JNZ  cell
+
+    LDI  r1, 0x4800         ; trace
+    LDI  r3, 32
+    LDI  r0, 0
+trace:
+    LD   r5, [r1]
+    ADD  r0, r5
+    ADDI r1, 33
+    SUBI r3, 1
+    JNZ  trace
+    ST   r0, [0xFF12]
+
+    LDI  r1, 0x4800         ; sum
+    LDI  r3, 1024
+    LDI  r0, 0
+sum:
+    LD   r5, [r1]
+    ADD  r0, r5
+    ADDI r1, 1
+    SUBI r3, 1
+    JNZ  sum
+    ST   r0, [0xFF12]
+    HALT
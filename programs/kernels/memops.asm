@@ -0,0 +1,106 @@
+; Kernel: block memset/memcpy, unrolled 8 words per iteration. A 4K-word
+; source ramp a[i] = 3i + 1 is built at 0x4000 once; each of 16 passes then
+; memsets the 4K-word buffer at 0x5000 to the pass number, memcpys 4080 words
+; from a + pass over it and checksums the whole buffer. Prints the sum of all
+; checksums mod 2^16 and the last word of the buffer:
+;   1920
+;   16
+
+.org 0x0000
+start:
+    LDI  r1, 0x4000
+    LDI  r2, 4096
+    LDI  r0, 1
+ramp:
+    ST   r0, [r1]
+    ADDI r0, 3
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  ramp
+
+    LDI  r4, 1              ; pass (fill value)
+    LDI  r5, 0              ; running checksum
+pass:
+    ; memset(0x5000, pass, 4096)
+    LDI  r1, 0x5000
+    LDI  r2, 512
+fill:
+    ST   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r1]
+    ADDI r1, 1
+    ST   r4, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  fill
+
+    ; memcpy(0x5000, 0x4000 + pass, 4080)
+    LDI  r1, 0x4000
+    ADD  r1, r4
+    LDI  r3, 0x5000
+    LDI  r2, 510
+copy:
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    LD   r0, [r1]
+    ST   r0, [r3]
+    ADDI r1, 1
+    ADDI r3, 1
+    SUBI r2, 1
+    JNZ  copy
+
+    ; checksum the buffer
+    LDI  r1, 0x5000
+    LDI  r2, 4096
+sum:
+    LD   r0, [r1]
+    ADD  r5, r0
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  sum
+
+    ADDI r4, 1
+    LDI  r0, 17
+    CMP  r4, r0
+    JNZ  pass
+
+    ST   r5, [0xFF12]
+    LD   r0, [0x5FFF]
+    ST   r0, [0xFF12]
+    HALT
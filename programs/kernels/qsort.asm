@@ -0,0 +1,92 @@
+; Kernel: recursive quicksort (Lomuto partition, last element as pivot) of
+; 1024 pseudo-random words at 0x4000 (LCG x = x * 25173 + 13849, seed 7),
+; unsigned ascending. Prints sum(a[i] * (i + 1)) mod 2^16 and 1 if sorted:
+;   6914
+;   1
+
+.org 0x0000
+start:
+    LDI  r1, 0x4000
+    LDI  r2, 1024
+    LDI  r0, 7              ; x
+    LDI  r3, 25173
+gen:
+    MUL  r0, r3
+    ADDI r0, 13849
+    ST   r0, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  gen
+
+    LDI  r1, 0x4000
+    LDI  r2, 0x43FF
+    CALL qsort
+
+    LDI  r1, 0x4000
+    LDI  r2, 1024
+    CALL check
+    HALT
+
+; qsort(r1 = first, r2 = last), inclusive pointers; clobbers r0..r6
+qsort:
+    CMP  r1, r2
+    JC   qs_partition       ; first < last
+    RET
+qs_partition:
+    LD   r3, [r2]           ; pivot
+    MOV  r4, r1             ; store position
+    MOV  r5, r1             ; scan position
+qs_scan:
+    CMP  r5, r2
+    JZ   qs_split
+    LD   r0, [r5]
+    CMP  r0, r3
+    JC   qs_swap            ; a[scan] < pivot
+    JMP  qs_next
+qs_swap:
+    LD   r6, [r4]
+    ST   r0, [r4]
+    ST   r6, [r5]
+    ADDI r4, 1
+qs_next:
+    ADDI r5, 1
+    JMP  qs_scan
+qs_split:
+    LD   r6, [r4]           ; pivot goes to the store position
+    ST   r3, [r4]
+    ST   r6, [r2]
+    PUSH r2
+    PUSH r4
+    MOV  r2, r4
+    SUBI r2, 1
+    CALL qsort              ; left part
+    POP  r4
+    POP  r2
+    MOV  r1, r4
+    ADDI r1, 1
+    JMP  qsort              ; right part (tail call)
+
+; check(r1 = array, r2 = n > 0): prints sum(a[i] * (i + 1)) and a sorted flag
+check:
+    LDI  r0, 0
+    LDI  r4, 1
+    LDI  r6, 1
+    LDI  r3, 0
+check_loop:
+    LD   r5, [r1]
+    CMP  r5, r3
+    JC   check_unsorted
+    JMP  check_sum
+check_unsorted:
+    LDI  r6, 0
+check_sum:
+    MOV  r3, r5
+    MUL  r5, r4
+    ADD  r0, r5
+    ADDI r4, 1
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  check_loop
+    ST   r0, [0xFF12]
+    ST   r6, [0xFF12]
+    RET
@@ -0,0 +1,63 @@
+; Kernel: sieve of Eratosthenes over [0, 8192), one flag word per number
+; at 0x4000 (1 = prime). Prints the number of primes below 8192 and the
+; largest of them:
+;   1028
+;   8191
+
+.org 0x0000
+start:
+    ; flags[i] = 1 for every i
+    LDI  r1, 0x4000
+    LDI  r2, 8192
+    LDI  r3, 1
+init:
+    ST   r3, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  init
+
+    LDI  r4, 2              ; i
+outer:
+    MOV  r5, r4
+    MUL  r5, r4             ; j = i * i
+    LDI  r0, 8192
+    CMP  r5, r0
+    JC   test_i             ; i * i < N
+    JMP  count
+test_i:
+    LDI  r1, 0x4000
+    ADD  r1, r4
+    LD   r0, [r1]
+    JZ   next_i             ; i already crossed out
+    LDI  r3, 0
+mark:
+    LDI  r1, 0x4000
+    ADD  r1, r5
+    ST   r3, [r1]           ; flags[j] = 0
+    ADD  r5, r4             ; j += i
+    LDI  r0, 8192
+    CMP  r5, r0
+    JC   mark
+next_i:
+    ADDI r4, 1
+    JMP  outer
+
+count:
+    LDI  r1, 0x4002
+    LDI  r2, 8190
+    LDI  r4, 2              ; i
+    LDI  r0, 0              ; primes found
+    LDI  r5, 0              ; largest prime
+cnt:
+    LD   r3, [r1]
+    JZ   cnt_next
+    ADDI r0, 1
+    MOV  r5, r4
+cnt_next:
+    ADDI r1, 1
+    ADDI r4, 1
+    SUBI r2, 1
+    JNZ  cnt
+    ST   r0, [0xFF12]
+    ST   r5, [0xFF12]
+    HALT
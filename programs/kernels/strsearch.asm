@@ -0,0 +1,62 @@
+; Kernel: naive substring search. Builds a 4096-character text of 'a'/'b'
+; at 0x4000 (bit 15 of the LCG x = x * 25173 + 13849, seed 11), then scans it
+; for the zero-terminated pattern "abbab" at every position. Prints the
+; number of (possibly overlapping) matches and the index of the first one:
+;   132
+;   32
+
+.org 0x0000
+start:
+    LDI  r1, 0x4000
+    LDI  r2, 4096
+    LDI  r0, 11             ; x
+    LDI  r3, 25173
+    LDI  r5, 15
+gen:
+    MUL  r0, r3
+    ADDI r0, 13849
+    MOV  r4, r0
+    SHR  r4, r5
+    ADDI r4, 97             ; 'a' + bit
+    ST   r4, [r1]
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  gen
+
+    LDI  r1, 0x4000         ; candidate start
+    LDI  r2, 4092           ; positions left (4096 - 5 + 1)
+    LDI  r0, 0              ; matches
+scan:
+    MOV  r4, r1
+    LDI  r3, pattern
+cmp_char:
+    LD   r5, [r3]
+    JZ   found              ; end of pattern: every character matched
+    LD   r6, [r4]
+    CMP  r5, r6
+    JNZ  next_pos
+    ADDI r3, 1
+    ADDI r4, 1
+    JMP  cmp_char
+found:
+    ADDI r0, 1
+    LD   r6, [first]
+    ADDI r6, 1
+    JNZ  next_pos           ; already set (first != 0xFFFF)
+    MOV  r6, r1
+    SUBI r6, 0x4000
+    ST   r6, [first]
+next_pos:
+    ADDI r1, 1
+    SUBI r2, 1
+    JNZ  scan
+
+    ST   r0, [0xFF12]
+    LD   r0, [first]
+    ST   r0, [0xFF12]
+    HALT
+
+first:
+    .word 0xFFFF
+pattern:
+    .asciiz "abbab"
@@ -0,0 +1,62 @@
+; Multi-core demo: run with `emu16 --cores N multicore.bin`.
+; Every core bumps two shared counters 100 times each:
+;   - `hits` with the atomic FADD instruction
+;   - `guarded` with a plain LD/ADD/ST inside a CAS spinlock
+; Core 0 then waits for all cores and prints both totals (N * 100 twice).
+; Plain LD/ST are not ordered across host threads (--threads), so every
+; hand-off between cores goes through CAS/FADD: the lock is released with a
+; CAS and `done` is polled with a FADD of 0.
+
+.org 0x0000
+start:
+    LD   r6, [0xFF31]   ; r6 = core count
+    LDI  r5, 100        ; iterations left
+    LDI  r4, hits
+    LDI  r3, lock
+loop:
+    LDI  r0, 1
+    FADD r0, [r4]       ; hits += 1
+
+acquire:
+    LDI  r0, 0          ; expected: unlocked
+    LDI  r1, 1          ; desired: locked
+    CAS  r0, r1, [r3]
+    JNZ  acquire        ; Z=0 -> someone else holds it
+    LD   r0, [guarded]
+    ADDI r0, 1
+    ST   r0, [guarded]
+    LDI  r0, 1          ; expected: held by us
+    LDI  r1, 0          ; desired: unlocked
+    CAS  r0, r1, [r3]   ; release
+
+    SUBI r5, 1
+    JNZ  loop
+
+    LDI  r4, done
+    LDI  r0, 1
+    FADD r0, [r4]       ; done += 1
+
+    LD   r1, [0xFF30]   ; only core 0 reports
+    LDI  r0, 0
+    CMP  r1, r0
+    JNZ  finish
+wait:
+    LDI  r0, 0
+    FADD r0, [r4]       ; r0 = done, ordered after the other cores' updates
+    CMP  r0, r6
+    JNZ  wait
+    LD   r0, [hits]
+    ST   r0, [0xFF12]
+    LD   r0, [guarded]
+    ST   r0, [0xFF12]
+finish:
+    HALT
+
+hits:
+    .word 0
+guarded:
+    .word 0
+lock:
+    .word 0
+done:
+    .word 0
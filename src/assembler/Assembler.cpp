@@ -17,7 +17,8 @@
  *       - .asciiz "text"    : emit zero-terminated string (1 byte per word)
  *   • Supported instructions (subset): MOV/ADD/SUB/AND/OR/XOR/NOT/SHL/SHR/CMP,
  *     PUSH/POP, LD/ST absolute & indirect, LDI/LEA/ADDI/SUBI, JMP/JZ/JNZ/JC/JN,
- *     CALL/RET/HALT, and MUL. See `ISA::Opcode` for encodings.
+ *     CALL/RET/HALT, MUL, and the atomics CAS/FADD. See `ISA::Opcode` for
+ *     encodings.
  *
  * Design notes
  *   • Word-addressed memory: addresses are in units of 16‑bit words.
@@ -83,6 +84,8 @@ namespace ISA
         ADDI = 0x1B,
         SUBI = 0x1C,
         MUL = 0x1D,
+        CAS = 0x1E,
+        FADD = 0x1F,
     };
 }
 
@@ -188,13 +191,41 @@ public:
                 line = line.substr(0, p);
             lines.push_back(line);
         }
+        src = path;
         first_pass(lines);
         return second_pass(lines);
     }
 
+    // Label -> address table from the last assemble_file() call
+    const std::unordered_map<std::string, uint16_t> &symbols() const
+    {
+        return sym;
+    }
+
+    // Per-address source line (1-based, 0 = not emitted) of the last image
+    const std::vector<uint32_t> &line_map() const
+    {
+        return line_of;
+    }
+
+    // Targets of every .org, in source order
+    const std::vector<uint16_t> &org_addresses() const
+    {
+        return orgs;
+    }
+
+    const std::string &source() const
+    {
+        return src;
+    }
+
 private:
     std::unordered_map<std::string, uint16_t> sym;
     uint16_t loc = 0;
+    std::string src;
+    std::vector<uint32_t> line_of;
+    std::vector<uint16_t> orgs;
+    uint32_t cur_line = 0;
 
         // Pass 1: determine sizes and record label addresses (location counter)
 
@@ -258,8 +289,12 @@ private:
     {
         std::vector<uint16_t> out;
         loc = 0;
+        line_of.clear();
+        orgs.clear();
+        cur_line = 0;
         for (auto raw : lines)
         {
+            cur_line++;
             std::string line = trim(raw);
             if (line.empty())
                 continue;
@@ -271,6 +306,7 @@ private:
             {
                 auto toks = tokenize(line);
                 loc = parse_imm(toks[1]);
+                orgs.push_back(loc);
                 while (out.size() < loc)
                     out.push_back(0);
                 continue;
@@ -437,6 +473,30 @@ private:
                 continue;
             }
 
+            if (op == "CAS")
+            {
+                // CAS rd, rs, [ra]: third register lives in bits [4:2]
+                if (toks.size() != 4 || !is_register(toks[1]) || !is_register(toks[2]))
+                    throw std::runtime_error("CAS rd, rs, [ra]");
+                std::string m = toks[3];
+                if (m.size() < 3 || m.front() != '[' || m.back() != ']' || !is_register(m.substr(1, m.size() - 2)))
+                    throw std::runtime_error("CAS needs [ra]");
+                uint16_t ra = reg_id(m.substr(1, m.size() - 2));
+                ensure_size(out, loc);
+                out[loc++] = (uint16_t)(encode_R(ISA::CAS, reg_id(toks[1]), reg_id(toks[2])) | ((ra & 7) << 2));
+                continue;
+            }
+            if (op == "FADD")
+            {
+                if (toks.size() != 3 || !is_register(toks[1]))
+                    throw std::runtime_error("FADD rd, [rs]");
+                std::string m = toks[2];
+                if (m.size() < 3 || m.front() != '[' || m.back() != ']' || !is_register(m.substr(1, m.size() - 2)))
+                    throw std::runtime_error("FADD needs [rs]");
+                putR(ISA::FADD, reg_id(toks[1]), reg_id(m.substr(1, m.size() - 2)));
+                continue;
+            }
+
             if (op == "JMP" || op == "JZ" || op == "JNZ" || op == "JC" || op == "JN" || op == "CALL")
             {
                 uint16_t opc = (op == "JMP") ? ISA::JMP : (op == "JZ") ? ISA::JZ
@@ -455,10 +515,14 @@ private:
         return out;
     }
 
-    static inline void ensure_size(std::vector<uint16_t> &out, uint16_t at)
+    // Every emitted word goes through here, so it also tags the source line
+    inline void ensure_size(std::vector<uint16_t> &out, uint16_t at)
     {
         if (out.size() <= at)
             out.resize(at + 1, 0);
+        if (line_of.size() <= at)
+            line_of.resize(at + 1, 0);
+        line_of[at] = cur_line;
     }
     static inline std::string upper(std::string s)
     {
@@ -1,17 +1,62 @@
 
 #include <iostream>
 #include <string>
+#include <iomanip>
+#include <algorithm>
 #include "Assembler.cpp"
 
 static void usage(const char* argv0){
-    std::cerr << "Usage: " << argv0 << " <file.asm> -o <out.bin>\n";
+    std::cerr << "Usage: " << argv0 << " <file.asm> -o <out.bin> [--sym <out.sym>] [--map <out.map>]\n";
+}
+
+// Source map for emu16 --map. Text, one record per line, addresses in hex:
+//   # emu16-map 1
+//   file <path>
+//   section <start> <end>          emitted words [start, end), split at .org
+//   label <addr> <name>            sorted by address
+//   line <addr> <count> <line>     count words starting at addr came from source line
+static bool write_map(const Assembler& as, const std::string& path, size_t& records){
+    std::ofstream m(path);
+    if(!m) return false;
+    const std::vector<uint32_t>& lines = as.line_map();
+    std::vector<bool> org_at(lines.size() + 1, false);
+    for(uint16_t o : as.org_addresses()) if(o < org_at.size()) org_at[o] = true;
+    m << "# emu16-map 1\nfile " << as.source() << "\n";
+    m.setf(std::ios::hex, std::ios::basefield);
+    m.setf(std::ios::uppercase);
+    m.fill('0');
+    records = 0;
+    for(size_t a = 0; a < lines.size();){
+        if(!lines[a]){ a++; continue; }
+        size_t b = a + 1;
+        while(b < lines.size() && lines[b] && !org_at[b]) b++;
+        m << "section " << std::setw(4) << a << " " << std::setw(4) << b << "\n";
+        records++;
+        a = b;
+    }
+    std::vector<std::pair<uint16_t, std::string>> labels;
+    for(const auto& kv : as.symbols()) labels.push_back({kv.second, kv.first});
+    std::sort(labels.begin(), labels.end());
+    for(const auto& l : labels) m << "label " << std::setw(4) << l.first << " " << l.second << "\n";
+    records += labels.size();
+    for(size_t a = 0; a < lines.size();){
+        if(!lines[a]){ a++; continue; }
+        size_t b = a + 1;
+        while(b < lines.size() && lines[b] == lines[a]) b++;
+        m << "line " << std::setw(4) << a << " " << std::dec << (b - a) << " " << lines[a] << std::hex << "\n";
+        records++;
+        a = b;
+    }
+    return bool(m);
 }
 
 int main(int argc, char** argv){
-    std::string in, out="a.bin";
+    std::string in, out="a.bin", sym, map;
     for(int i=1;i<argc;i++){
         std::string a = argv[i];
         if(a == "-o" && i+1<argc){ out = argv[++i]; }
+        else if(a == "--sym" && i+1<argc){ sym = argv[++i]; }
+        else if(a == "--map" && i+1<argc){ map = argv[++i]; }
         else if(a.rfind("-",0)==0){ usage(argv[0]); return 1; }
         else in = a;
     }
@@ -35,5 +80,24 @@ int main(int argc, char** argv){
         f.put((char)hi);
     }
     std::cout << "Wrote " << words.size()*2 << " bytes to " << out << "\n";
+
+    if(!sym.empty()){
+        // One "ADDR label" line per label, sorted by address (emu16 --sym)
+        std::vector<std::pair<uint16_t, std::string>> labels;
+        for(const auto& kv : as.symbols()) labels.push_back({kv.second, kv.first});
+        std::sort(labels.begin(), labels.end());
+        std::ofstream s(sym);
+        if(!s){ std::cerr << "Failed to open " << sym << " for writing\n"; return 1; }
+        s.setf(std::ios::hex, std::ios::basefield);
+        s.setf(std::ios::uppercase);
+        s.fill('0');
+        for(const auto& l : labels) s << std::setw(4) << l.first << " " << l.second << "\n";
+        std::cout << "Wrote " << labels.size() << " symbols to " << sym << "\n";
+    }
+    if(!map.empty()){
+        size_t records = 0;
+        if(!write_map(as, map, records)){ std::cerr << "Failed to write " << map << "\n"; return 1; }
+        std::cout << "Wrote " << records << " map records to " << map << "\n";
+    }
     return 0;
 }
@@ -0,0 +1,269 @@
+/**
+ * bench16 — emulator throughput benchmark
+ * -----------------------------------------------------------------------------
+ * Runs every program of the suite on every engine, --runs times after one
+ * warm-up run, and reports the median and 10th/90th percentile guest MIPS.
+ * The suite is the throughput loops in programs/bench plus the workload
+ * kernels in programs/kernels (sorting, sieve, CRC, matmul, ...), all
+ * assembled by the build. The warm-up run's console output and cycle count
+ * are checked against the recorded values first, so a broken build fails
+ * instead of benchmarking garbage.
+ *
+ * --check only does that checking run, on every engine, and prints
+ * instructions and cycles per program: the CI gate for ISA and emulator
+ * changes. A change that legitimately alters a cycle count updates SUITE.
+ *
+ * Engines:
+ *   interp  the plain interpreter loop (what emu16 runs by default)
+ *   probed  the probed loop with one no-op probe attached (the floor for
+ *           every profiler/trace option)
+ *   micro   the microcoded sequencer (Microcode.cpp), one microstate per
+ *           datapath clock
+ *
+ * --json writes the results; --baseline compares against such a file and
+ * exits with status 2 when any median dropped by more than --threshold
+ * percent (default 5).
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../emulator/Emu16.cpp"
+#include "../emulator/Loader.cpp"
+#include "../emulator/Microcode.cpp"
+
+#ifndef BENCH16_DIR
+#define BENCH16_DIR "bench"
+#endif
+
+struct BenchProgram {
+    const char* name;
+    const char* what;
+    const char* expect;  // last console line(s)
+    uint64_t cycles;     // recorded guest cycles
+};
+
+static const BenchProgram SUITE[] = {
+    {"fib24",     "deep recursion, recursive fib(24)",                "46368",               3151026},
+    {"memloop",   "fill/sum loops over a 4K-word buffer",             "59392",               6555271},
+    {"mmio",      "TX_STR/TX_CHAR/TX_INT output, 60K device writes",  "emu16 bench, *19999", 420007},
+    {"calls",     "three-level call chains, PUSH/POP",                "22320",               4050010},
+    {"mul",       "MUL-heavy LCG and Horner checksum",                "24256",               6200054},
+    // programs/kernels
+    {"sieve",     "sieve of Eratosthenes below 8192",                 "1028\n8191",          418174},
+    {"isort",     "insertion sort, 256 words",                        "26594\n1",            365605},
+    {"qsort",     "recursive quicksort, 1024 words",                  "6914\n1",             282483},
+    {"memops",    "unrolled memset/memcpy, 16 x 4K words",            "1920\n16",            1902457},
+    {"crc16",     "bitwise CRC-16/CCITT over 8K bytes",               "10673\n63180",        842971},
+    {"matmul",    "32x32 matrix multiply with MUL",                   "11796\n8840",         712107},
+    {"strsearch", "naive substring search in 4K characters",          "132\n32",             249361},
+    {"interp",    "stack bytecode VM, jump-table dispatch",           "41080\n40320",        783246},
+};
+
+struct BenchEngine {
+    const char* name;
+    std::function<void(Emu16&)> run;
+};
+
+static std::vector<BenchEngine> engines(){
+    static NullProbe null_probe;
+    return {
+        {"interp", [](Emu16& e){ e.run(); }},
+        {"probed", [](Emu16& e){ e.attach(&null_probe); e.run(); e.detach(&null_probe); }},
+        {"micro",  [](Emu16& e){ MicroEngine m; while(!e.halted) m.run_for(e, UINT64_MAX); }},
+    };
+}
+
+struct BenchResult {
+    std::string program, engine;
+    uint64_t instructions = 0, cycles = 0;
+    double median = 0, p10 = 0, p90 = 0; // MIPS
+};
+
+static void usage(const char* argv0){
+    std::cerr << "Usage: " << argv0 << " [--list] [--check] [--dir <bench dir>] [--runs <n>] [--only <program>] [--engine <name>]\n"
+              << "       [--json <out.json>] [--baseline <file.json> [--threshold <percent>]]\n";
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double>& v, double p){
+    size_t k = size_t(p / 100.0 * double(v.size() - 1) + 0.5);
+    return v[std::min(k, v.size() - 1)];
+}
+
+// The last `lines` console lines, trailing newlines dropped
+static std::string last_lines(const std::string& out, size_t lines){
+    size_t end = out.size();
+    while(end && out[end - 1] == '\n') end--;
+    size_t start = end;
+    for(size_t n = 0; n < lines && start; ++n){
+        size_t nl = out.rfind('\n', start - 1);
+        start = (nl == std::string::npos) ? 0 : nl;
+    }
+    if(start < end && out[start] == '\n') start++;
+    return out.substr(start, end - start);
+}
+
+// Checks a finished run against the recorded output and cycle count
+static bool verify(const BenchProgram& prog, const char* engine, const Emu16& emu, const std::string& out){
+    size_t lines = size_t(std::count(prog.expect, prog.expect + std::strlen(prog.expect), '\n')) + 1;
+    std::string got = last_lines(out, lines);
+    if(emu.faulted || got != prog.expect){
+        std::cerr << "bench16: " << prog.name << " on " << engine << (emu.faulted ? " faulted, " : " ")
+                  << "printed \"" << got << "\", expected \"" << prog.expect << "\"\n";
+        return false;
+    }
+    if(emu.cycles != prog.cycles){
+        std::cerr << "bench16: " << prog.name << " on " << engine << " took " << emu.cycles
+                  << " cycles, recorded " << prog.cycles << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads what --json wrote: (program, engine) -> median MIPS.
+static bool load_baseline(const std::string& path, std::map<std::string, double>& out){
+    std::ifstream f(path);
+    if(!f) return false;
+    std::string line;
+    while(std::getline(f, line)){
+        auto field = [&](const std::string& key) -> std::string {
+            size_t k = line.find("\"" + key + "\": ");
+            if(k == std::string::npos) return "";
+            k += key.size() + 4;
+            if(line[k] == '"') return line.substr(k + 1, line.find('"', k + 1) - k - 1);
+            return line.substr(k, line.find_first_of(",}", k) - k);
+        };
+        std::string p = field("program"), e = field("engine"), m = field("median_mips");
+        if(!p.empty() && !e.empty() && !m.empty()) out[p + "/" + e] = std::strtod(m.c_str(), nullptr);
+    }
+    return true;
+}
+
+int main(int argc, char** argv){
+    std::string dir = BENCH16_DIR, json, baseline, only, only_engine;
+    unsigned runs = 11;
+    double threshold = 5.0;
+    bool check = false;
+    for(int i=1;i<argc;i++){
+        std::string a = argv[i];
+        if(a == "--dir" && i+1 < argc) dir = argv[++i];
+        else if(a == "--runs" && i+1 < argc) runs = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        else if(a == "--only" && i+1 < argc) only = argv[++i];
+        else if(a == "--engine" && i+1 < argc) only_engine = argv[++i];
+        else if(a == "--json" && i+1 < argc) json = argv[++i];
+        else if(a == "--baseline" && i+1 < argc) baseline = argv[++i];
+        else if(a == "--threshold" && i+1 < argc) threshold = std::strtod(argv[++i], nullptr);
+        else if(a == "--check") check = true;
+        else if(a == "--list"){
+            for(const BenchProgram& p : SUITE) std::cout << std::left << std::setw(11) << p.name << p.what << "\n";
+            for(const BenchEngine& e : engines()) std::cout << "engine " << e.name << "\n";
+            return 0;
+        }
+        else { usage(argv[0]); return 1; }
+    }
+    if(runs == 0){ usage(argv[0]); return 1; }
+
+    if(check)
+        std::cout << std::left << std::setw(11) << "program" << std::setw(8) << "engine" << std::right
+                  << std::setw(12) << "insts" << std::setw(12) << "cycles" << "\n";
+    std::vector<BenchResult> results;
+    int failures = 0;
+    for(const BenchProgram& prog : SUITE){
+        if(!only.empty() && only != prog.name) continue;
+        std::vector<uint16_t> rom;
+        std::string path = dir + "/" + prog.name + ".bin";
+        if(!load_image(path, rom)){ std::cerr << "bench16: cannot open " << path << "\n"; return 1; }
+        for(const BenchEngine& eng : engines()){
+            if(!only_engine.empty() && only_engine != eng.name) continue;
+            BenchResult r;
+            r.program = prog.name;
+            r.engine = eng.name;
+            std::vector<double> mips;
+            for(unsigned k = 0; k <= (check ? 0 : runs); ++k){
+                Emu16 emu(false);
+                std::ostringstream out;
+                emu.mem.io.out = (k == 0) ? &out : nullptr; // warm-up run is checked, timed runs are silent
+                emu.load(rom, 0x0000);
+                emu.reset();
+                auto t0 = std::chrono::steady_clock::now();
+                eng.run(emu);
+                double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                if(k == 0){
+                    if(!verify(prog, eng.name, emu, out.str())){
+                        if(!check) return 1;
+                        failures++;
+                    }
+                    r.instructions = emu.retired;
+                    r.cycles = emu.cycles;
+                    continue;
+                }
+                mips.push_back(dt > 0 ? double(emu.retired) / dt / 1e6 : 0.0);
+            }
+            if(check){
+                std::cout << std::left << std::setw(11) << r.program << std::setw(8) << r.engine << std::right
+                          << std::setw(12) << r.instructions << std::setw(12) << r.cycles << "\n";
+                continue;
+            }
+            std::sort(mips.begin(), mips.end());
+            r.median = percentile(mips, 50);
+            r.p10 = percentile(mips, 10);
+            r.p90 = percentile(mips, 90);
+            results.push_back(r);
+        }
+    }
+
+    if(check){
+        if(failures){ std::cerr << "bench16: " << failures << " check(s) failed\n"; return 1; }
+        std::cout << "all outputs and cycle counts match\n";
+        return 0;
+    }
+
+    std::map<std::string, double> base;
+    if(!baseline.empty() && !load_baseline(baseline, base)){ std::cerr << "bench16: cannot read " << baseline << "\n"; return 1; }
+    int regressions = 0;
+    std::cout << std::left << std::setw(11) << "program" << std::setw(8) << "engine" << std::right
+              << std::setw(12) << "insts" << std::setw(10) << "p10" << std::setw(10) << "median" << std::setw(10) << "p90"
+              << (base.empty() ? "" : "   vs baseline") << "\n";
+    for(const BenchResult& r : results){
+        std::cout << std::left << std::setw(11) << r.program << std::setw(8) << r.engine << std::right
+                  << std::setw(12) << r.instructions << std::fixed << std::setprecision(1)
+                  << std::setw(10) << r.p10 << std::setw(10) << r.median << std::setw(10) << r.p90;
+        auto b = base.find(r.program + "/" + r.engine);
+        if(b != base.end() && b->second > 0){
+            double change = 100.0 * (r.median - b->second) / b->second;
+            std::cout << "   " << std::showpos << change << std::noshowpos << "%";
+            if(change < -threshold){ std::cout << "  REGRESSION"; regressions++; }
+        }
+        std::cout << "\n";
+    }
+    std::cout << "(guest MIPS over " << runs << " runs)\n";
+
+    if(!json.empty()){
+        std::ofstream jf(json);
+        if(!jf){ std::cerr << "bench16: cannot write " << json << "\n"; return 1; }
+        jf << "{\"version\": \"" << EMU16_VERSION << "\", \"runs\": " << runs << ", \"results\": [\n" << std::fixed << std::setprecision(3);
+        for(size_t i = 0; i < results.size(); ++i){
+            const BenchResult& r = results[i];
+            jf << "  {\"program\": \"" << r.program << "\", \"engine\": \"" << r.engine << "\", \"instructions\": " << r.instructions
+               << ", \"cycles\": " << r.cycles << ", \"p10_mips\": " << r.p10 << ", \"median_mips\": " << r.median
+               << ", \"p90_mips\": " << r.p90 << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        jf << "]}\n";
+    }
+    if(regressions){
+        std::cerr << "bench16: " << regressions << " result(s) more than " << threshold << "% below baseline\n";
+        return 2;
+    }
+    return 0;
+}
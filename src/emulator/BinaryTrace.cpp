@@ -0,0 +1,433 @@
+#pragma once
+
+/**
+ * Binary execution trace (BinaryTrace.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --trace-bin out.e16t` attaches a BinaryTrace probe. Per retired
+ * instruction it fills one fixed-size TraceRecord (PC, first word, registers
+ * that changed, flags, the store it made, cycles) directly in a
+ * single-producer/single-consumer ring. A writer thread drains the ring,
+ * delta-compresses the records and appends them to the file; the emulator
+ * only waits when the ring is full. `trace16` decodes the file offline.
+ *
+ * A TraceFilter (PC range and cycle window) decides which instructions are
+ * recorded. Skipped instructions still change state, so the next recorded
+ * instruction carries every register that differs from what the decoder
+ * last saw and the decoded register file is always exact.
+ *
+ * File layout (little-endian, varints are LEB128, zz = zigzag):
+ *     "E16TRC01" | R0..R7 u16 | PC u16 | flags u8 | cycles u64
+ *     then per record:
+ *       tag u8: 1 = inst, 2 = regs, 4 = flags, 8 = store
+ *       zz(pc - previous pc) | cycles - previous cycles
+ *       [inst u16: only when it differs from the last word seen at pc]
+ *       [mask u8, one varint per set bit] [flags u8] [zz(addr delta), value]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Emu16.cpp"
+
+// [TraceRecord] One retired instruction, as kept in the ring
+struct TraceRecord
+{
+    uint64_t cycles = 0;  // cycle count when the instruction started
+    uint16_t pc = 0;
+    uint16_t inst = 0;    // first word
+    uint8_t reg_mask = 0; // bit n: rn changed, new value in regs[n]
+    uint8_t flags = 0;    // N Z C V in bits 3..0, after the instruction
+    bool has_store = false;
+    uint16_t regs[8] = {0};
+    uint16_t store_addr = 0, store_value = 0;
+};
+
+static inline uint8_t pack_flags(const Flags &f)
+{
+    return uint8_t((f.N << 3) | (f.Z << 2) | (f.C << 1) | int(f.V));
+}
+
+// [TraceFilter] Capture/display window
+struct TraceFilter
+{
+    uint16_t pc_lo = 0, pc_hi = 0xFFFF;
+    uint64_t cycle_lo = 0, cycle_hi = UINT64_MAX;
+
+    bool match(uint16_t pc, uint64_t cycles) const
+    {
+        return pc >= pc_lo && pc <= pc_hi && cycles >= cycle_lo && cycles <= cycle_hi;
+    }
+};
+
+// "lo:hi" with either side optional ("0x100:", ":5000"); numbers in any base.
+static inline bool parse_trace_range(const std::string &s, uint64_t &lo, uint64_t &hi)
+{
+    size_t c = s.find(':');
+    if (c == std::string::npos)
+        return false;
+    try
+    {
+        if (c > 0)
+            lo = std::stoull(s.substr(0, c), nullptr, 0);
+        if (c + 1 < s.size())
+            hi = std::stoull(s.substr(c + 1), nullptr, 0);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return lo <= hi;
+}
+
+// [TraceCodec] Delta coding state shared by writer and reader
+struct TraceCodec
+{
+    static constexpr char MAGIC[8] = {'E', '1', '6', 'T', 'R', 'C', '0', '1'};
+    enum : uint8_t
+    {
+        TAG_INST = 1,
+        TAG_REGS = 2,
+        TAG_FLAGS = 4,
+        TAG_STORE = 8,
+    };
+
+    uint16_t prev_pc = 0;
+    uint64_t prev_cycles = 0;
+    uint8_t prev_flags = 0;
+    uint16_t prev_store = 0;
+    std::vector<uint16_t> inst_at = std::vector<uint16_t>(65536, 0);
+
+    static void put_varint(std::string &o, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            o.push_back(char(uint8_t(v) | 0x80));
+            v >>= 7;
+        }
+        o.push_back(char(uint8_t(v)));
+    }
+    static bool get_varint(std::istream &in, uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int c = in.get();
+            if (c == EOF)
+                return false;
+            v |= uint64_t(c & 0x7F) << shift;
+            if (!(c & 0x80))
+                return true;
+        }
+        return false;
+    }
+    static uint64_t zigzag(int64_t v)
+    {
+        return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+    }
+    static int64_t unzigzag(uint64_t v)
+    {
+        return int64_t(v >> 1) ^ -int64_t(v & 1);
+    }
+
+    void encode(const TraceRecord &r, std::string &o)
+    {
+        uint8_t tag = 0;
+        if (inst_at[r.pc] != r.inst)
+            tag |= TAG_INST;
+        if (r.reg_mask)
+            tag |= TAG_REGS;
+        if (r.flags != prev_flags)
+            tag |= TAG_FLAGS;
+        if (r.has_store)
+            tag |= TAG_STORE;
+        o.push_back(char(tag));
+        put_varint(o, zigzag(int64_t(r.pc) - int64_t(prev_pc)));
+        put_varint(o, r.cycles - prev_cycles);
+        if (tag & TAG_INST)
+        {
+            o.push_back(char(uint8_t(r.inst)));
+            o.push_back(char(uint8_t(r.inst >> 8)));
+        }
+        if (tag & TAG_REGS)
+        {
+            o.push_back(char(r.reg_mask));
+            for (int i = 0; i < 8; i++)
+                if (r.reg_mask & (1u << i))
+                    put_varint(o, r.regs[i]);
+        }
+        if (tag & TAG_FLAGS)
+            o.push_back(char(r.flags));
+        if (tag & TAG_STORE)
+        {
+            put_varint(o, zigzag(int64_t(r.store_addr) - int64_t(prev_store)));
+            put_varint(o, r.store_value);
+        }
+        advance(r);
+    }
+
+    bool decode(std::istream &in, TraceRecord &r)
+    {
+        int tag = in.get();
+        uint64_t v = 0;
+        if (tag == EOF || !get_varint(in, v))
+            return false;
+        r = TraceRecord();
+        r.pc = uint16_t(int64_t(prev_pc) + unzigzag(v));
+        if (!get_varint(in, v))
+            return false;
+        r.cycles = prev_cycles + v;
+        r.inst = inst_at[r.pc];
+        if (tag & TAG_INST)
+        {
+            int lo = in.get(), hi = in.get();
+            if (hi == EOF)
+                return false;
+            r.inst = uint16_t(lo | (hi << 8));
+        }
+        if (tag & TAG_REGS)
+        {
+            int m = in.get();
+            if (m == EOF)
+                return false;
+            r.reg_mask = uint8_t(m);
+            for (int i = 0; i < 8; i++)
+            {
+                if (!(r.reg_mask & (1u << i)))
+                    continue;
+                if (!get_varint(in, v))
+                    return false;
+                r.regs[i] = uint16_t(v);
+            }
+        }
+        r.flags = prev_flags;
+        if (tag & TAG_FLAGS)
+        {
+            int f = in.get();
+            if (f == EOF)
+                return false;
+            r.flags = uint8_t(f);
+        }
+        if (tag & TAG_STORE)
+        {
+            if (!get_varint(in, v))
+                return false;
+            r.has_store = true;
+            r.store_addr = uint16_t(int64_t(prev_store) + unzigzag(v));
+            if (!get_varint(in, v))
+                return false;
+            r.store_value = uint16_t(v);
+        }
+        advance(r);
+        return true;
+    }
+
+private:
+    void advance(const TraceRecord &r)
+    {
+        inst_at[r.pc] = r.inst;
+        prev_pc = r.pc;
+        prev_cycles = r.cycles;
+        prev_flags = r.flags;
+        if (r.has_store)
+            prev_store = r.store_addr;
+    }
+};
+
+// [TraceHeader] Machine state when recording started
+struct TraceHeader
+{
+    uint16_t R[8] = {0};
+    uint16_t PC = 0;
+    uint8_t flags = 0;
+    uint64_t cycles = 0;
+};
+
+// [BinaryTrace] Probe + ring + writer thread
+class BinaryTrace : public Probe
+{
+public:
+    static constexpr size_t DEFAULT_RING_RECORDS = 1u << 16; // power of two
+
+    TraceFilter filter;
+    uint64_t recorded = 0;
+    uint64_t stalls = 0; // times the core waited for the writer
+
+    explicit BinaryTrace(size_t ring_records = DEFAULT_RING_RECORDS)
+        : ring(ring_records), mask(ring_records - 1) {}
+    ~BinaryTrace()
+    {
+        close();
+    }
+
+    // Write the header from the core's current state and start the writer.
+    bool open(const std::string &path, const Emu16 &cpu)
+    {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        TraceHeader h;
+        for (int i = 0; i < 8; i++)
+            h.R[i] = shadow[i] = cpu.R[i];
+        h.PC = cpu.PC;
+        h.flags = shadow_flags = pack_flags(cpu.F);
+        h.cycles = cpu.cycles;
+        std::string o(TraceCodec::MAGIC, sizeof(TraceCodec::MAGIC));
+        for (uint16_t r : h.R)
+            o.append({char(uint8_t(r)), char(uint8_t(r >> 8))});
+        o.append({char(uint8_t(h.PC)), char(uint8_t(h.PC >> 8)), char(h.flags)});
+        for (int i = 0; i < 8; i++)
+            o.push_back(char(uint8_t(h.cycles >> (8 * i))));
+        file.write(o.data(), std::streamsize(o.size()));
+        codec.prev_pc = h.PC;
+        codec.prev_cycles = h.cycles;
+        codec.prev_flags = h.flags;
+        bytes = o.size();
+        done.store(false);
+        writer = std::thread([this]
+                             { drain(); });
+        return true;
+    }
+
+    // Flush everything still in the ring and close the file. Returns bytes written.
+    uint64_t close()
+    {
+        if (writer.joinable())
+        {
+            done.store(true, std::memory_order_release);
+            writer.join();
+            file.close();
+        }
+        return bytes;
+    }
+
+    void on_store(Emu16 &, uint16_t addr, uint16_t value) override
+    {
+        store_pending = true;
+        store_addr = addr;
+        store_value = value;
+    }
+
+    void on_retire(Emu16 &cpu, uint16_t pc, uint16_t inst, uint64_t cycles_before) override
+    {
+        const bool had_store = store_pending;
+        store_pending = false;
+        if (!filter.match(pc, cycles_before))
+            return;
+        uint64_t h = head.load(std::memory_order_relaxed);
+        while (h - tail.load(std::memory_order_acquire) >= ring.size())
+        {
+            stalls++;
+            std::this_thread::yield();
+        }
+        TraceRecord &r = ring[h & mask];
+        r.cycles = cycles_before;
+        r.pc = pc;
+        r.inst = inst;
+        r.reg_mask = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            if (cpu.R[i] != shadow[i])
+            {
+                r.reg_mask |= uint8_t(1u << i);
+                r.regs[i] = shadow[i] = cpu.R[i];
+            }
+        }
+        r.flags = shadow_flags = pack_flags(cpu.F);
+        r.has_store = had_store;
+        r.store_addr = store_addr;
+        r.store_value = store_value;
+        head.store(h + 1, std::memory_order_release);
+        recorded++;
+    }
+
+private:
+    std::vector<TraceRecord> ring;
+    const uint64_t mask;
+    std::atomic<uint64_t> head{0}, tail{0};
+    std::atomic<bool> done{false};
+    std::thread writer;
+    std::ofstream file;
+    TraceCodec codec;
+    uint64_t bytes = 0;
+
+    uint16_t shadow[8] = {0};
+    uint8_t shadow_flags = 0;
+    bool store_pending = false;
+    uint16_t store_addr = 0, store_value = 0;
+
+    void drain()
+    {
+        std::string out;
+        for (;;)
+        {
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            uint64_t h = head.load(std::memory_order_acquire);
+            if (t == h)
+            {
+                if (done.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == t)
+                    break;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            for (; t != h; ++t)
+                codec.encode(ring[t & mask], out);
+            tail.store(h, std::memory_order_release);
+            if (out.size() >= (1u << 16))
+                flush(out);
+        }
+        flush(out);
+    }
+
+    void flush(std::string &out)
+    {
+        file.write(out.data(), std::streamsize(out.size()));
+        bytes += out.size();
+        out.clear();
+    }
+};
+
+// [TraceReader] Sequential decoder for trace16
+struct TraceReader
+{
+    TraceHeader header;
+    uint16_t R[8] = {0}; // register file after the last decoded record
+
+    bool open(const std::string &path)
+    {
+        in.open(path, std::ios::binary);
+        char magic[8];
+        if (!in.read(magic, sizeof(magic)) || std::string(magic, 8) != std::string(TraceCodec::MAGIC, 8))
+            return false;
+        uint8_t b[27];
+        if (!in.read(reinterpret_cast<char *>(b), sizeof(b)))
+            return false;
+        for (int i = 0; i < 8; i++)
+            header.R[i] = R[i] = uint16_t(b[2 * i] | (b[2 * i + 1] << 8));
+        header.PC = uint16_t(b[16] | (b[17] << 8));
+        header.flags = b[18];
+        for (int i = 0; i < 8; i++)
+            header.cycles |= uint64_t(b[19 + i]) << (8 * i);
+        codec.prev_pc = header.PC;
+        codec.prev_cycles = header.cycles;
+        codec.prev_flags = header.flags;
+        return true;
+    }
+
+    bool next(TraceRecord &r)
+    {
+        if (!codec.decode(in, r))
+            return false;
+        for (int i = 0; i < 8; i++)
+            if (r.reg_mask & (1u << i))
+                R[i] = r.regs[i];
+        return true;
+    }
+
+private:
+    std::ifstream in;
+    TraceCodec codec;
+};
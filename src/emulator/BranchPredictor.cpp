@@ -0,0 +1,311 @@
+#pragma once
+
+/**
+ * Branch predictor simulation (BranchPredictor.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --bpred gshare:12,bimodal:10,btfn` runs every listed predictor side
+ * by side on the conditional jumps (JZ/JNZ/JC/JN) of one ordinary run, and a
+ * return-address stack (--ras <depth>, default 8) on CALL/RET:
+ *
+ *   nt, taken     static: always not-taken / always taken,
+ *   btfn          static: backward taken, forward not-taken,
+ *   bimodal:N     2^N two-bit saturating counters indexed by PC,
+ *   gshare:N      2^N two-bit counters indexed by PC xor N bits of global
+ *                 history.
+ *
+ * The target of every Jcc is its second word, so only the direction is
+ * predicted. Each mispredict costs MISPREDICT_PENALTY cycles and each RAS
+ * miss RAS_MISS_PENALTY, the extra flush cost in the five-stage pipeline
+ * model (Pipeline.cpp); `--pipeline` runs with the first listed predictor.
+ * The report gives per predictor the mispredict rate and penalty cycles,
+ * and per branch PC the mispredict rate under each predictor.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Emu16.cpp"
+#include "Report.cpp"
+#include "Symbols.cpp"
+
+struct BranchPredictor
+{
+    static constexpr uint64_t MISPREDICT_PENALTY = 2;
+    static constexpr uint64_t RAS_MISS_PENALTY = 2;
+
+    std::string name;
+
+    virtual ~BranchPredictor() = default;
+    virtual bool predict(uint16_t pc, uint16_t target) = 0;
+    virtual void update(uint16_t pc, bool taken) = 0;
+
+    // "nt", "taken", "btfn", "bimodal[:bits]", "gshare[:bits]"; null and
+    // `err` set on a bad spec.
+    static std::unique_ptr<BranchPredictor> create(const std::string &spec, std::string &err);
+};
+
+struct StaticPredictor : BranchPredictor
+{
+    enum Mode
+    {
+        NotTaken,
+        Taken,
+        Btfn,
+    };
+    Mode mode;
+
+    explicit StaticPredictor(Mode m) : mode(m) {}
+    bool predict(uint16_t pc, uint16_t target) override
+    {
+        return mode == Taken || (mode == Btfn && target <= pc);
+    }
+    void update(uint16_t, bool) override {}
+};
+
+// Two-bit saturating counters; 0-1 predict not-taken, 2-3 taken.
+struct CounterTable
+{
+    std::vector<uint8_t> ctr;
+    uint32_t mask;
+
+    explicit CounterTable(unsigned bits) : ctr(size_t(1) << bits, 1), mask((1u << bits) - 1) {}
+    bool predict(uint32_t i) const
+    {
+        return ctr[i & mask] >= 2;
+    }
+    void update(uint32_t i, bool taken)
+    {
+        uint8_t &c = ctr[i & mask];
+        if (taken && c < 3)
+            c++;
+        else if (!taken && c > 0)
+            c--;
+    }
+};
+
+struct BimodalPredictor : BranchPredictor
+{
+    CounterTable table;
+
+    explicit BimodalPredictor(unsigned bits) : table(bits) {}
+    bool predict(uint16_t pc, uint16_t) override
+    {
+        return table.predict(pc);
+    }
+    void update(uint16_t pc, bool taken) override
+    {
+        table.update(pc, taken);
+    }
+};
+
+struct GsharePredictor : BranchPredictor
+{
+    CounterTable table;
+    uint32_t history = 0;
+
+    explicit GsharePredictor(unsigned bits) : table(bits) {}
+    bool predict(uint16_t pc, uint16_t) override
+    {
+        return table.predict(pc ^ history);
+    }
+    void update(uint16_t pc, bool taken) override
+    {
+        table.update(pc ^ history, taken);
+        history = ((history << 1) | uint32_t(taken)) & table.mask;
+    }
+};
+
+inline std::unique_ptr<BranchPredictor> BranchPredictor::create(const std::string &spec, std::string &err)
+{
+    std::string kind = spec, arg;
+    size_t colon = spec.find(':');
+    if (colon != std::string::npos)
+    {
+        kind = spec.substr(0, colon);
+        arg = spec.substr(colon + 1);
+    }
+    std::unique_ptr<BranchPredictor> p;
+    unsigned bits = 12;
+    if (!arg.empty())
+    {
+        char *end = nullptr;
+        bits = unsigned(std::strtoul(arg.c_str(), &end, 0));
+        if (*end || bits < 1 || bits > 24)
+        {
+            err = "table bits must be 1..24 in '" + spec + "'";
+            return nullptr;
+        }
+    }
+    if (kind == "nt" || kind == "taken" || kind == "btfn")
+    {
+        if (!arg.empty())
+        {
+            err = "static predictor '" + kind + "' takes no size";
+            return nullptr;
+        }
+        p.reset(new StaticPredictor(kind == "nt" ? StaticPredictor::NotTaken : kind == "taken" ? StaticPredictor::Taken
+                                                                                              : StaticPredictor::Btfn));
+        p->name = kind;
+        return p;
+    }
+    if (kind == "bimodal")
+        p.reset(new BimodalPredictor(bits));
+    else if (kind == "gshare")
+        p.reset(new GsharePredictor(bits));
+    else
+    {
+        err = "unknown predictor '" + kind + "' (nt, taken, btfn, bimodal:N, gshare:N)";
+        return nullptr;
+    }
+    p->name = kind + ":" + std::to_string(bits);
+    return p;
+}
+
+// Circular return-address stack: overflow drops the oldest entry.
+struct ReturnStack
+{
+    std::vector<uint16_t> slots;
+    size_t top = 0, depth = 0;
+
+    explicit ReturnStack(unsigned n) : slots(std::max(1u, n), 0) {}
+    void push(uint16_t ra)
+    {
+        top = (top + 1) % slots.size();
+        slots[top] = ra;
+        depth = std::min(depth + 1, slots.size());
+    }
+    // Predicted return address, or false when the stack is empty
+    bool pop(uint16_t &ra)
+    {
+        if (!depth)
+            return false;
+        ra = slots[top];
+        top = (top + slots.size() - 1) % slots.size();
+        depth--;
+        return true;
+    }
+};
+
+struct BranchSim : Probe
+{
+    struct Entry
+    {
+        std::unique_ptr<BranchPredictor> predictor;
+        uint64_t mispredicts = 0;
+        std::vector<uint64_t> pc_mispredicts;
+    };
+
+    std::vector<Entry> entries;
+    ReturnStack ras;
+    uint64_t branches = 0, taken = 0;
+    uint64_t returns = 0, ras_misses = 0;
+    std::vector<uint64_t> pc_execs, pc_taken;
+
+    explicit BranchSim(unsigned ras_depth) : ras(ras_depth), pc_execs(65536, 0), pc_taken(65536, 0) {}
+
+    void add(std::unique_ptr<BranchPredictor> p)
+    {
+        entries.push_back(Entry());
+        entries.back().predictor = std::move(p);
+        entries.back().pc_mispredicts.assign(65536, 0);
+    }
+
+    void on_flow(Emu16 &, Flow kind, uint16_t pc, uint16_t target, bool t) override
+    {
+        if (kind == Flow::Call)
+            ras.push(uint16_t(pc + 2));
+        else if (kind == Flow::Ret)
+        {
+            uint16_t ra = 0;
+            returns++;
+            if (!ras.pop(ra) || ra != target)
+                ras_misses++;
+        }
+        else if (kind == Flow::Branch)
+        {
+            branches++;
+            taken += t;
+            pc_execs[pc]++;
+            pc_taken[pc] += t;
+            for (Entry &e : entries)
+            {
+                if (e.predictor->predict(pc, target) != t)
+                {
+                    e.mispredicts++;
+                    e.pc_mispredicts[pc]++;
+                }
+                e.predictor->update(pc, t);
+            }
+        }
+    }
+
+    void report(std::ostream &o, const Symbols &sym, size_t top = 10) const
+    {
+        o << "=== branch prediction: " << branches << " conditional branches (" << std::fixed << std::setprecision(1)
+          << pct(taken, branches) << "% taken), " << returns << " returns ===\n"
+          << "  predictor       mispredicts   rate%  penalty cycles\n";
+        for (const Entry &e : entries)
+            o << "  " << std::left << std::setw(14) << e.predictor->name << std::right << std::setw(13) << e.mispredicts
+              << std::setw(8) << std::setprecision(2) << pct(e.mispredicts, branches) << std::setw(16)
+              << e.mispredicts * BranchPredictor::MISPREDICT_PENALTY << "\n";
+        o << "  " << std::left << std::setw(14) << ("ras:" + std::to_string(ras.slots.size())) << std::right
+          << std::setw(13) << ras_misses << std::setw(8) << pct(ras_misses, returns) << std::setw(16)
+          << ras_misses * BranchPredictor::RAS_MISS_PENALTY << "\n"
+          << "--- most mispredicted branches (" << (entries.empty() ? "" : entries.front().predictor->name) << ") ---\n"
+          << "  pc          execs  taken%";
+        for (const Entry &e : entries)
+            o << std::setw(12) << e.predictor->name;
+        o << "  symbol\n";
+        for (uint16_t pc : top_pcs(top))
+        {
+            o << "  " << Emu16::hex4(pc) << std::setw(11) << pc_execs[pc] << std::setw(8) << std::setprecision(1)
+              << pct(pc_taken[pc], pc_execs[pc]);
+            for (const Entry &e : entries)
+                o << std::setw(11) << pct(e.pc_mispredicts[pc], pc_execs[pc]) << "%";
+            o << "  " << sym.format(pc) << "\n";
+        }
+    }
+
+    void write_json(std::ostream &o, const Symbols &sym) const
+    {
+        o << "{\n  \"branches\": " << branches << ",\n  \"taken\": " << taken << ",\n  \"predictors\": [";
+        for (size_t i = 0; i < entries.size(); ++i)
+            o << (i ? ",\n" : "\n") << "    {\"name\": \"" << entries[i].predictor->name << "\", \"mispredicts\": "
+              << entries[i].mispredicts << ", \"penalty_cycles\": "
+              << entries[i].mispredicts * BranchPredictor::MISPREDICT_PENALTY << "}";
+        o << "\n  ],\n  \"ras\": {\"depth\": " << ras.slots.size() << ", \"returns\": " << returns
+          << ", \"misses\": " << ras_misses << ", \"penalty_cycles\": " << ras_misses * BranchPredictor::RAS_MISS_PENALTY
+          << "},\n  \"sites\": [";
+        bool first = true;
+        for (uint32_t pc = 0; pc < 65536; ++pc)
+        {
+            if (!pc_execs[pc])
+                continue;
+            o << (first ? "\n" : ",\n") << "    {\"pc\": \"" << Emu16::hex4(uint16_t(pc)) << "\", \"symbol\": \""
+              << json_escape(sym.format(uint16_t(pc))) << "\", \"executions\": " << pc_execs[pc] << ", \"taken\": " << pc_taken[pc]
+              << ", \"mispredicts\": {";
+            for (size_t i = 0; i < entries.size(); ++i)
+                o << (i ? ", " : "") << "\"" << entries[i].predictor->name << "\": " << entries[i].pc_mispredicts[pc];
+            o << "}}";
+            first = false;
+        }
+        o << "\n  ]\n}\n";
+    }
+
+private:
+    // By mispredicts under the first predictor, then executions
+    std::vector<uint16_t> top_pcs(size_t top) const
+    {
+        return ::top_pcs(top, [&](uint16_t pc)
+                         {
+                             uint64_t miss = entries.empty() ? 0 : entries.front().pc_mispredicts[pc];
+                             return std::make_pair(miss, pc_execs[pc]); });
+    }
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+/**
+ * Instruction and data cache simulator (CacheSim.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --icache 1024:2:8 --dcache 2048:4:8:lru:wb` puts a set-associative
+ * cache model in front of the 64K-word RAM on each side of a split (Harvard)
+ * memory system:
+ *
+ *   icache  instruction words, both words of a two-word instruction,
+ *   dcache  data (LD, ST, CAS, FADD) and stack (PUSH, POP, CALL, RET).
+ *
+ * A spec is size:ways:line:replacement:write, sizes in words and powers of
+ * two; replacement is lru, fifo or random, write is wb (write-back,
+ * write-allocate) or wt (write-through, no write-allocate). Missing fields
+ * keep their defaults. The MMIO page (0xFF00..0xFFFF) is uncached.
+ *
+ * Hits and misses are counted per kind (fetch, data, stack) and per PC. With
+ * --miss-penalty N every miss, and every dirty line written back, adds N
+ * cycles to the core's cycle count as the access happens, so TIMER reads
+ * and --max-cycles see the slower machine; without it the run's timing is
+ * unchanged. The model is fed by the probe hooks rather than the Memory
+ * read path, which is where the PC and the access kind are known. A lookup
+ * is one set scan, cheap enough to stay synchronous with the core.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+#include "Report.cpp"
+#include "Symbols.cpp"
+
+struct CacheConfig
+{
+    enum Replacement
+    {
+        LRU,
+        FIFO,
+        Random,
+    };
+
+    uint32_t size = 1024; // words
+    uint32_t ways = 2;
+    uint32_t line = 8; // words
+    Replacement replacement = LRU;
+    bool write_back = true; // false: write-through, no write-allocate
+
+    // "size[:ways[:line[:lru|fifo|random[:wb|wt]]]]"
+    bool parse(const std::string &spec, std::string &err)
+    {
+        std::vector<std::string> f;
+        std::stringstream ss(spec);
+        std::string part;
+        while (std::getline(ss, part, ':'))
+            f.push_back(part);
+        uint32_t *nums[3] = {&size, &ways, &line};
+        for (size_t i = 0; i < f.size() && i < 3; ++i)
+        {
+            char *end = nullptr;
+            unsigned long v = std::strtoul(f[i].c_str(), &end, 0);
+            if (f[i].empty() || *end || v == 0 || v > 65536)
+                return fail(err, "bad number '" + f[i] + "'");
+            *nums[i] = uint32_t(v);
+        }
+        if (f.size() > 3)
+        {
+            if (f[3] == "lru")
+                replacement = LRU;
+            else if (f[3] == "fifo")
+                replacement = FIFO;
+            else if (f[3] == "random")
+                replacement = Random;
+            else
+                return fail(err, "replacement must be lru, fifo or random");
+        }
+        if (f.size() > 4)
+        {
+            if (f[4] != "wb" && f[4] != "wt")
+                return fail(err, "write policy must be wb or wt");
+            write_back = f[4] == "wb";
+        }
+        if (f.empty() || f.size() > 5)
+            return fail(err, "expected size[:ways[:line[:replacement[:write]]]]");
+        auto pow2 = [](uint32_t v)
+        { return (v & (v - 1)) == 0; };
+        if (!pow2(size) || !pow2(ways) || !pow2(line))
+            return fail(err, "size, ways and line must be powers of two");
+        if (uint64_t(ways) * line > size) // each up to 65536: 32 bits can overflow
+            return fail(err, "ways * line exceeds the cache size");
+        return true;
+    }
+
+    std::string describe() const
+    {
+        static const char *names[] = {"lru", "fifo", "random"};
+        std::ostringstream o;
+        o << size << ":" << ways << ":" << line << ":" << names[replacement] << ":" << (write_back ? "wb" : "wt");
+        return o.str();
+    }
+
+private:
+    static bool fail(std::string &err, const std::string &why)
+    {
+        err = why;
+        return false;
+    }
+};
+
+// One set-associative cache: tags only, no data.
+struct Cache
+{
+    struct Result
+    {
+        bool hit;
+        bool writeback; // a dirty line was evicted
+    };
+
+    CacheConfig cfg;
+    uint64_t accesses = 0, misses = 0, writebacks = 0;
+
+    explicit Cache(const CacheConfig &c) : cfg(c)
+    {
+        sets = cfg.size / (cfg.ways * cfg.line);
+        while ((1u << line_shift) < cfg.line)
+            line_shift++;
+        tags.assign(size_t(sets) * cfg.ways, INVALID);
+        stamp.assign(tags.size(), 0);
+        dirty.assign(tags.size(), 0);
+    }
+
+    Result access(uint16_t addr, bool write)
+    {
+        accesses++;
+        tick++;
+        const uint32_t block = uint32_t(addr) >> line_shift;
+        const size_t base = size_t(block & (sets - 1)) * cfg.ways;
+        for (size_t i = base; i < base + cfg.ways; ++i)
+        {
+            if (tags[i] != block)
+                continue;
+            if (cfg.replacement == CacheConfig::LRU)
+                stamp[i] = tick;
+            if (write && cfg.write_back)
+                dirty[i] = 1;
+            return {true, false};
+        }
+        misses++;
+        if (write && !cfg.write_back)
+            return {false, false}; // no write-allocate
+        size_t victim = base;
+        if (cfg.replacement == CacheConfig::Random)
+        {
+            victim = base + size_t(next_random() & (cfg.ways - 1));
+            for (size_t i = base; i < base + cfg.ways; ++i)
+                if (tags[i] == INVALID)
+                {
+                    victim = i;
+                    break;
+                }
+        }
+        else
+        {
+            for (size_t i = base + 1; i < base + cfg.ways; ++i)
+                if (stamp[i] < stamp[victim])
+                    victim = i;
+        }
+        bool wb = tags[victim] != INVALID && dirty[victim];
+        writebacks += wb;
+        tags[victim] = block;
+        stamp[victim] = tick;
+        dirty[victim] = uint8_t(write && cfg.write_back);
+        return {false, wb};
+    }
+
+private:
+    static constexpr uint32_t INVALID = UINT32_MAX;
+    uint32_t sets = 1, line_shift = 0;
+    std::vector<uint32_t> tags;
+    std::vector<uint64_t> stamp; // LRU: last use, FIFO: fill; invalid lines stay 0
+    std::vector<uint8_t> dirty;
+    uint64_t tick = 0;
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+    uint64_t next_random()
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    }
+};
+
+struct CacheSim : Probe
+{
+    enum Kind
+    {
+        Fetch,
+        Data,
+        Stack,
+        KINDS,
+    };
+
+    std::unique_ptr<Cache> icache, dcache;
+    uint32_t miss_penalty = 0;
+    uint64_t added_cycles = 0;
+    uint64_t accesses[KINDS] = {0}, misses[KINDS] = {0};
+    std::vector<uint64_t> pc_misses[KINDS];
+
+    CacheSim(const CacheConfig *i, const CacheConfig *d, uint32_t penalty) : miss_penalty(penalty)
+    {
+        if (i)
+            icache.reset(new Cache(*i));
+        if (d)
+            dcache.reset(new Cache(*d));
+        for (auto &v : pc_misses)
+            v.assign(65536, 0);
+    }
+
+    void on_retire(Emu16 &cpu, uint16_t pc, uint16_t inst, uint64_t) override
+    {
+        if (!icache)
+            return;
+        access(cpu, *icache, Fetch, pc, pc, false);
+        if (ISA::words(inst >> 11) == 2)
+            access(cpu, *icache, Fetch, pc, uint16_t(pc + 1), false);
+    }
+
+    void on_load(Emu16 &cpu, uint16_t addr, uint16_t) override
+    {
+        data(cpu, addr, false);
+    }
+
+    void on_store(Emu16 &cpu, uint16_t addr, uint16_t) override
+    {
+        data(cpu, addr, true);
+    }
+
+    void report(std::ostream &o, const Symbols &sym, size_t top = 10) const
+    {
+        o << "=== caches: miss penalty " << miss_penalty << " cycles, " << added_cycles << " cycles added ===\n"
+          << "  cache    config                  accesses      misses   miss%  writebacks\n";
+        cache_row(o, "icache", icache.get());
+        cache_row(o, "dcache", dcache.get());
+        o << "  kind     accesses      misses   miss%\n";
+        static const char *names[KINDS] = {"fetch", "data", "stack"};
+        for (int k = 0; k < KINDS; ++k)
+            o << "  " << std::left << std::setw(6) << names[k] << std::right << std::setw(11) << accesses[k]
+              << std::setw(12) << misses[k] << std::setw(7) << std::fixed << std::setprecision(2)
+              << pct(misses[k], accesses[k]) << "%\n";
+        o << "--- top missing PCs ---\n"
+          << "  pc          fetch        data       stack  symbol\n";
+        for (uint16_t pc : top_pcs(top))
+        {
+            o << "  " << Emu16::hex4(pc);
+            for (int k = 0; k < KINDS; ++k)
+                o << std::setw(12) << pc_misses[k][pc];
+            o << "  " << sym.format(pc) << "\n";
+        }
+    }
+
+    void write_json(std::ostream &o, const Symbols &sym, size_t top = 64) const
+    {
+        static const char *names[KINDS] = {"fetch", "data", "stack"};
+        o << "{\n  \"miss_penalty\": " << miss_penalty << ",\n  \"added_cycles\": " << added_cycles << ",\n  \"caches\": {";
+        bool first = true;
+        for (const Cache *c : {icache.get(), dcache.get()})
+        {
+            if (!c)
+                continue;
+            o << (first ? "" : ", ") << "\"" << (c == icache.get() ? "icache" : "dcache") << "\": {\"config\": \""
+              << c->cfg.describe() << "\", \"accesses\": " << c->accesses << ", \"misses\": " << c->misses
+              << ", \"writebacks\": " << c->writebacks << "}";
+            first = false;
+        }
+        o << "},\n  \"kinds\": {";
+        for (int k = 0; k < KINDS; ++k)
+            o << (k ? ", " : "") << "\"" << names[k] << "\": {\"accesses\": " << accesses[k] << ", \"misses\": "
+              << misses[k] << "}";
+        o << "},\n  \"top_pcs\": [";
+        first = true;
+        for (uint16_t pc : top_pcs(top))
+        {
+            o << (first ? "\n" : ",\n") << "    {\"pc\": \"" << Emu16::hex4(pc) << "\", \"symbol\": \"" << json_escape(sym.format(pc)) << "\"";
+            for (int k = 0; k < KINDS; ++k)
+                o << ", \"" << names[k] << "_misses\": " << pc_misses[k][pc];
+            o << "}";
+            first = false;
+        }
+        o << "\n  ]\n}\n";
+    }
+
+private:
+    void data(Emu16 &cpu, uint16_t addr, bool write)
+    {
+        if (!dcache || addr >= 0xFF00)
+            return;
+        const uint16_t op = (cpu.cur_inst >> 11) & 0x1F;
+        const bool stack = op == ISA::PUSH || op == ISA::POP || op == ISA::CALL || op == ISA::RET;
+        access(cpu, *dcache, stack ? Stack : Data, cpu.cur_pc.load(std::memory_order_relaxed), addr, write);
+    }
+
+    void access(Emu16 &cpu, Cache &c, Kind k, uint16_t pc, uint16_t addr, bool write)
+    {
+        Cache::Result r = c.access(addr, write);
+        accesses[k]++;
+        if (r.hit)
+            return;
+        misses[k]++;
+        pc_misses[k][pc]++;
+        // A write-through store miss goes to the write buffer, not the core
+        const uint64_t stall = uint64_t(miss_penalty) * ((write && !c.cfg.write_back ? 0 : 1) + r.writeback);
+        cpu.cycles += stall;
+        added_cycles += stall;
+    }
+
+    // By total misses
+    std::vector<uint16_t> top_pcs(size_t top) const
+    {
+        return ::top_pcs(top, [&](uint16_t pc)
+                         { return pc_misses[Fetch][pc] + pc_misses[Data][pc] + pc_misses[Stack][pc]; });
+    }
+
+    static void cache_row(std::ostream &o, const char *name, const Cache *c)
+    {
+        if (!c)
+        {
+            o << "  " << std::left << std::setw(9) << name << std::right << "off\n";
+            return;
+        }
+        o << "  " << std::left << std::setw(9) << name << std::setw(20) << c->cfg.describe() << std::right
+          << std::setw(12) << c->accesses << std::setw(12) << c->misses << std::setw(7) << std::fixed
+          << std::setprecision(2) << pct(c->misses, c->accesses) << "%" << std::setw(12) << c->writebacks << "\n";
+    }
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+/**
+ * Call-graph profiler (CallGraph.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --callgraph out.folded` attaches this probe. Guest code calls and
+ * returns strictly through CALL/RET on r7, so a shadow stack of frames
+ * mirrors the guest's: CALL pushes the callee (return address = CALL + 2),
+ * RET pops back to the frame whose return address it jumps to. Code that
+ * unwinds the stack by hand only costs the extra frames, never a crash.
+ *
+ * Every instruction's cycles go to the frame on top of the stack (CALL to
+ * the caller, RET to the callee). Each distinct stack path is a node in a
+ * trie; the folded file is one "outer;...;inner <self cycles>" line per node,
+ * the input format of flamegraph.pl / speedscope. Inclusive cycles per
+ * function are counted only for its outermost activation, so recursion
+ * (fib calling fib) is not double-charged.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Emu16.cpp"
+#include "Report.cpp"
+#include "Symbols.cpp"
+
+struct CallGraph : Probe
+{
+    struct Node
+    {
+        uint16_t func = 0;
+        uint32_t parent = 0;
+        uint64_t self = 0;
+    };
+
+    struct Func
+    {
+        uint64_t calls = 0;
+        uint64_t self = 0;
+        uint64_t inclusive = 0;
+        uint32_t active = 0;    // activations currently on the stack
+        uint32_t max_active = 0;
+    };
+
+    struct Frame
+    {
+        uint16_t func;
+        uint16_t ret;       // address the matching RET returns to
+        uint32_t node;
+        uint64_t entry;     // cycles when the frame was entered
+        Func *stats;        // funcs[func]; map nodes never move
+    };
+
+    std::vector<Node> nodes;                          // [0] is the unnamed root
+    std::unordered_map<uint64_t, uint32_t> children;  // (parent << 16 | func) -> node
+    std::vector<Frame> stack;
+    std::unordered_map<uint16_t, Func> funcs;
+    size_t max_depth = 0;
+    uint64_t total_calls = 0;
+
+    CallGraph() : nodes(1) {}
+
+    void on_flow(Emu16 &, Flow kind, uint16_t pc, uint16_t target, bool) override
+    {
+        call.note(kind, pc, target);
+    }
+
+    void on_retire(Emu16 &cpu, uint16_t pc, uint16_t, uint64_t cycles_before) override
+    {
+        if (stack.empty())
+            enter(pc, 0, cycles_before);
+        const uint64_t spent = cpu.cycles - cycles_before;
+        nodes[stack.back().node].self += spent;
+        stack.back().stats->self += spent;
+
+        if (call.pending == Flow::Call)
+        {
+            enter(call.func, call.ret, cpu.cycles);
+            total_calls++;
+        }
+        else if (call.pending == Flow::Ret)
+        {
+            // The root frame (index 0) is never popped.
+            size_t keep = CallRet::unwind_to(stack.size(), 1, call.ret, [&](size_t i)
+                                             { return stack[i].ret; });
+            while (stack.size() > std::max<size_t>(keep, 1))
+                leave(cpu.cycles);
+        }
+        call.pending = Flow::Jump;
+    }
+
+    // Close every open frame (run stopped by HALT, fault or budget).
+    void finish(uint64_t now)
+    {
+        while (!stack.empty())
+            leave(now);
+    }
+
+    uint64_t total_cycles() const
+    {
+        uint64_t t = 0;
+        for (const Node &n : nodes)
+            t += n.self;
+        return t;
+    }
+
+    // One line per stack path with self cycles, outermost frame first.
+    void write_folded(std::ostream &o, const Symbols &sym) const
+    {
+        std::vector<std::string> path;
+        for (uint32_t i = 1; i < nodes.size(); ++i)
+        {
+            if (!nodes[i].self)
+                continue;
+            path.clear();
+            for (uint32_t n = i; n; n = nodes[n].parent)
+                path.push_back(sym.owner(nodes[n].func));
+            for (size_t k = path.size(); k-- > 0;)
+                o << path[k] << (k ? ";" : " ");
+            o << nodes[i].self << "\n";
+        }
+    }
+
+    void report(std::ostream &o, const Symbols &sym, size_t top = 15) const
+    {
+        std::vector<std::pair<uint16_t, Func>> rows(funcs.begin(), funcs.end());
+        std::sort(rows.begin(), rows.end(), [](const std::pair<uint16_t, Func> &a, const std::pair<uint16_t, Func> &b)
+                  { return a.second.inclusive != b.second.inclusive ? a.second.inclusive > b.second.inclusive
+                                                                    : a.first < b.first; });
+        const uint64_t total = total_cycles();
+        o << "=== call graph: " << total_calls << " calls, max depth " << max_depth << ", "
+          << total << " cycles ===\n"
+          << "         calls     inclusive   incl%          self   self%  depth  addr    function\n";
+        for (size_t i = 0; i < rows.size() && i < top; ++i)
+        {
+            const Func &f = rows[i].second;
+            o << "  " << std::setw(12) << f.calls << "  " << std::setw(12) << f.inclusive << "  "
+              << std::setw(6) << std::fixed << std::setprecision(2) << pct(f.inclusive, total) << "  "
+              << std::setw(12) << f.self << "  " << std::setw(6) << pct(f.self, total) << "  "
+              << std::setw(5) << f.max_active << "  " << Emu16::hex4(rows[i].first) << "  "
+              << sym.owner(rows[i].first) << "\n";
+        }
+    }
+
+private:
+    CallRet call;
+
+    void enter(uint16_t func, uint16_t ret, uint64_t now)
+    {
+        uint32_t parent = stack.empty() ? 0 : stack.back().node;
+        uint64_t k = (uint64_t(parent) << 16) | func;
+        auto it = children.find(k);
+        uint32_t node;
+        if (it != children.end())
+            node = it->second;
+        else
+        {
+            node = uint32_t(nodes.size());
+            nodes.push_back({func, parent, 0});
+            children.emplace(k, node);
+        }
+        Func &f = funcs[func];
+        stack.push_back({func, ret, node, now, &f});
+        f.calls++;
+        f.max_active = std::max(f.max_active, ++f.active);
+        max_depth = std::max(max_depth, stack.size());
+    }
+
+    void leave(uint64_t now)
+    {
+        const Frame fr = stack.back();
+        stack.pop_back();
+        if (--fr.stats->active == 0)
+            fr.stats->inclusive += now - fr.entry;
+    }
+};
@@ -0,0 +1,382 @@
+#pragma once
+
+/**
+ * Lockstep co-simulation (CoSim.cpp)
+ * -----------------------------------------------------------------------------
+ * Runs one program on two execution engines side by side and checks that
+ * they stay bit-identical. Each engine owns a private Emu16 (RAM, console
+ * sink); both advance in chunks of `every` guest cycles and the state hash
+ * (registers, PC, flags, halted/faulted, cycles, instructions retired, RAM
+ * and console output) is compared after every chunk.
+ *
+ * On the first mismatch both sides are rewound to the last agreeing
+ * checkpoint and the chunk is bisected on its cycle budget, replaying from
+ * the checkpoint each time, down to the single instruction after which the
+ * states first differ. The report names that instruction and lists the
+ * fields that differ.
+ *
+ * Engines are anything that can run an Emu16 for a cycle budget with the
+ * run_for() contract (stop at the first instruction boundary at or past the
+ * budget, or on HALT). New fast paths register in CoSim::engines() and get
+ * checked against the reference `interp` loop.
+ *
+ * RandomProgram generates straight-line-with-branches guest code over the
+ * whole ISA for cosim16 --random.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+#include "Microcode.cpp"
+
+struct CoSimEngine
+{
+    const char *name;
+    const char *what;
+    std::function<StopReason(Emu16 &, uint64_t max_cycles)> run_for;
+};
+
+struct CoSimResult
+{
+    bool diverged = false;
+    uint64_t cycles = 0;       // agreed up to here (reference side)
+    uint64_t instructions = 0; // retired by then
+    uint64_t checks = 0;       // hash comparisons made
+    bool halted = false;       // both sides halted in agreement
+
+    // Divergence details (diverged == true)
+    uint16_t pc = 0;        // instruction after which the states differ
+    uint16_t words[2] = {}; // its encoding
+    std::vector<std::string> diffs;
+};
+
+class CoSim
+{
+public:
+    static const std::vector<CoSimEngine> &engines()
+    {
+        static NullProbe null_probe;
+        static const std::vector<CoSimEngine> list = {
+            {"interp", "plain run loop (reference)",
+             [](Emu16 &e, uint64_t n)
+             { return e.run_for(n); }},
+            {"probed", "probed run loop, no-op probe attached",
+             [](Emu16 &e, uint64_t n)
+             {
+                 e.attach(&null_probe);
+                 StopReason r = e.run_for(n);
+                 e.detach(&null_probe);
+                 return r;
+             }},
+            {"step", "Emu16::step() one instruction at a time",
+             [](Emu16 &e, uint64_t n)
+             {
+                 uint64_t end = (n > UINT64_MAX - e.cycles) ? UINT64_MAX : e.cycles + n;
+                 while (!e.halted && e.cycles < end)
+                     e.step();
+                 return e.halted ? (e.faulted ? StopReason::Fault : StopReason::Halted) : StopReason::Budget;
+             }},
+            {"micro", "microcoded sequencer over the hw.dot datapath",
+             [](Emu16 &e, uint64_t n)
+             {
+                 MicroEngine m;
+                 return m.run_for(e, n);
+             }},
+        };
+        return list;
+    }
+
+    static const CoSimEngine *find_engine(const std::string &name)
+    {
+        for (const CoSimEngine &e : engines())
+            if (name == e.name)
+                return &e;
+        return nullptr;
+    }
+
+    CoSim(const CoSimEngine &a, const CoSimEngine &b) : side{Side(a), Side(b)} {}
+
+    // Self-test of the harness: engine B's r0 gets bit 0 flipped by the
+    // instruction that carries it to `cycle` or beyond.
+    void inject_fault(uint64_t cycle) { inject_at = cycle; }
+
+    CoSimResult run(const std::vector<uint16_t> &image, uint16_t base, uint64_t max_cycles, uint64_t every)
+    {
+        for (Side &s : side)
+        {
+            s.emu->reset();
+            s.emu->mem.mem.assign(s.emu->mem.mem.size(), 0);
+            s.emu->load(image, base);
+            s.emu->mem.io.out = &s.out;
+            s.out.str("");
+        }
+        CoSimResult res;
+        if (every == 0)
+            every = 1;
+        for (;;)
+        {
+            Checkpoint good[2] = {checkpoint(side[0]), checkpoint(side[1])};
+            uint64_t now = side[0].emu->cycles;
+            if (side[0].emu->halted && side[1].emu->halted)
+            {
+                res.halted = true;
+                break;
+            }
+            if (now >= max_cycles)
+                break;
+            uint64_t chunk = std::min(every, max_cycles - now);
+            advance(chunk);
+            res.checks++;
+            if (hash(side[0]) == hash(side[1]))
+                continue;
+            bisect(good, chunk, res);
+            break;
+        }
+        if (!res.diverged)
+        {
+            res.cycles = side[0].emu->cycles;
+            res.instructions = side[0].emu->retired;
+        }
+        return res;
+    }
+
+    // FNV-1a over everything an engine must reproduce exactly
+    static uint64_t hash(const Emu16 &e, const std::string &out)
+    {
+        uint64_t h = 0xCBF29CE484222325ull;
+        auto mix = [&h](const void *p, size_t n)
+        {
+            const uint8_t *b = static_cast<const uint8_t *>(p);
+            for (size_t i = 0; i < n; ++i)
+                h = (h ^ b[i]) * 0x100000001B3ull;
+        };
+        uint8_t bits[6] = {e.F.Z, e.F.N, e.F.C, e.F.V, e.halted, e.faulted};
+        mix(e.R, sizeof e.R);
+        mix(&e.PC, sizeof e.PC);
+        mix(bits, sizeof bits);
+        mix(&e.cycles, sizeof e.cycles);
+        mix(&e.retired, sizeof e.retired);
+        mix(e.mem.mem.data(), e.mem.mem.size() * sizeof(uint16_t));
+        mix(out.data(), out.size());
+        return h;
+    }
+
+private:
+    struct Side
+    {
+        explicit Side(const CoSimEngine &e) : engine(&e), emu(new Emu16(false))
+        {
+            emu->report_faults = false;
+            emu->mem.io.out = &out;
+        }
+        const CoSimEngine *engine;
+        std::unique_ptr<Emu16> emu;
+        std::ostringstream out;
+        std::string text; // out.str() as of the last hash
+    };
+
+    struct Checkpoint
+    {
+        Snapshot snap;
+        std::string out;
+    };
+
+    Side side[2];
+    uint64_t inject_at = UINT64_MAX;
+
+    uint64_t hash(Side &s)
+    {
+        s.text = s.out.str();
+        return hash(*s.emu, s.text);
+    }
+
+    static Checkpoint checkpoint(Side &s)
+    {
+        Checkpoint c;
+        c.snap = s.emu->snapshot();
+        c.out = s.out.str();
+        return c;
+    }
+    static void rewind(Side &s, const Checkpoint &c)
+    {
+        s.emu->restore(c.snap);
+        s.out.str("");
+        s.out << c.out;
+    }
+
+    void advance(uint64_t budget)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            Emu16 &e = *side[i].emu;
+            uint64_t c0 = e.cycles;
+            side[i].engine->run_for(e, budget);
+            if (i == 1 && c0 < inject_at && e.cycles >= inject_at)
+                e.R[0] ^= 1;
+        }
+    }
+
+    bool agree_after(const Checkpoint good[2], uint64_t budget)
+    {
+        rewind(side[0], good[0]);
+        rewind(side[1], good[1]);
+        advance(budget);
+        return hash(side[0]) == hash(side[1]);
+    }
+
+    // `bad` cycles past the checkpoint the states differ; find the smallest
+    // such budget, then report the instruction that ran last to reach it.
+    void bisect(const Checkpoint good[2], uint64_t bad, CoSimResult &res)
+    {
+        uint64_t ok = 0;
+        while (bad - ok > 1)
+        {
+            uint64_t mid = ok + (bad - ok) / 2;
+            if (agree_after(good, mid))
+                ok = mid;
+            else
+                bad = mid;
+        }
+        if (ok)
+            agree_after(good, ok);
+        else
+        {
+            rewind(side[0], good[0]);
+            rewind(side[1], good[1]);
+        }
+        const Emu16 &ref = *side[0].emu;
+        res.diverged = true;
+        res.cycles = ref.cycles;
+        res.instructions = ref.retired;
+        res.pc = ref.PC;
+        res.words[0] = ref.mem.mem[ref.PC];
+        res.words[1] = ref.mem.mem[uint16_t(ref.PC + 1)];
+        agree_after(good, bad);
+        res.diffs = diff(*side[0].emu, side[0].text, *side[1].emu, side[1].text);
+    }
+
+    static std::vector<std::string> diff(const Emu16 &a, const std::string &oa, const Emu16 &b, const std::string &ob)
+    {
+        std::vector<std::string> d;
+        auto field = [&d](const std::string &name, const std::string &va, const std::string &vb)
+        {
+            if (va != vb)
+                d.push_back(name + ": " + va + " vs " + vb);
+        };
+        for (int i = 0; i < 8; ++i)
+            field("r" + std::to_string(i), Emu16::hex4(a.R[i]), Emu16::hex4(b.R[i]));
+        field("PC", Emu16::hex4(a.PC), Emu16::hex4(b.PC));
+        field("FLAGS", flags_str(a.F), flags_str(b.F));
+        field("halted", a.halted ? "yes" : "no", b.halted ? "yes" : "no");
+        field("faulted", a.faulted ? "yes" : "no", b.faulted ? "yes" : "no");
+        field("cycles", std::to_string(a.cycles), std::to_string(b.cycles));
+        field("retired", std::to_string(a.retired), std::to_string(b.retired));
+        uint32_t shown = 0, differing = 0;
+        for (uint32_t addr = 0; addr < a.mem.mem.size(); ++addr)
+        {
+            if (a.mem.mem[addr] == b.mem.mem[addr])
+                continue;
+            if (shown++ < 8)
+                field("[" + Emu16::hex4(uint16_t(addr)) + "]", Emu16::hex4(a.mem.mem[addr]), Emu16::hex4(b.mem.mem[addr]));
+            differing++;
+        }
+        if (differing > 8)
+            d.push_back("... " + std::to_string(differing - 8) + " more memory words differ");
+        if (oa != ob)
+            d.push_back("console output: " + std::to_string(oa.size()) + " vs " + std::to_string(ob.size()) + " bytes");
+        return d;
+    }
+};
+
+// Random guest programs for differential testing. Every opcode is emitted
+// with random registers; branch and CALL targets land on instruction
+// boundaries of the program, absolute addresses mostly fall in a small data
+// window at 0x4000 (plus the console/timer devices), and the program ends in
+// HALT. Loops and runaway returns are cut off by the co-simulation budget.
+struct RandomProgram
+{
+    static constexpr uint16_t DATA = 0x4000;
+
+    static std::vector<uint16_t> generate(uint64_t seed, unsigned instructions)
+    {
+        uint64_t s = seed ? seed : 0x9E3779B97F4A7C15ull;
+        auto next = [&s]()
+        {
+            s ^= s >> 12;
+            s ^= s << 25;
+            s ^= s >> 27;
+            return s * 2685821657736338717ull;
+        };
+        auto below = [&next](uint32_t n)
+        { return uint32_t(next() % n); };
+
+        // Opcodes first, so jump targets can point at any instruction start
+        std::vector<uint16_t> ops, starts;
+        uint16_t at = 0;
+        for (unsigned i = 0; i < 7; ++i)
+        {
+            ops.push_back(ISA::LDI); // seed r0..r6
+            starts.push_back(at);
+            at += 2;
+        }
+        for (unsigned i = 0; i < instructions; ++i)
+        {
+            uint16_t op = uint16_t(below(32));
+            if (op == ISA::HALT && below(4))
+                op = ISA::NOP; // keep most programs running to the end
+            ops.push_back(op);
+            starts.push_back(at);
+            at = uint16_t(at + ISA::words(op));
+        }
+        ops.push_back(ISA::HALT);
+        starts.push_back(at);
+
+        std::vector<uint16_t> image;
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            uint16_t op = ops[i];
+            uint16_t rd = uint16_t(i < 7 ? i : below(7)), rs = uint16_t(below(8));
+            uint16_t w = uint16_t(op << 11 | rd << 8 | rs << 5);
+            if (op == ISA::CAS)
+                w |= uint16_t(below(7) << 2);
+            image.push_back(w);
+            if (ISA::words(op) == 1)
+                continue;
+            switch (op)
+            {
+            case ISA::JMP:
+            case ISA::JZ:
+            case ISA::JNZ:
+            case ISA::JC:
+            case ISA::JN:
+            case ISA::CALL:
+                image.push_back(starts[below(uint32_t(starts.size()))]);
+                break;
+            case ISA::LD_ABS:
+            case ISA::ST_ABS:
+                image.push_back(address(below));
+                break;
+            default: // LDI/LEA/ADDI/SUBI
+                image.push_back(below(2) ? uint16_t(next()) : address(below));
+                break;
+            }
+        }
+        return image;
+    }
+
+private:
+    template <class Below>
+    static uint16_t address(Below &below)
+    {
+        static const uint16_t devices[] = {0xFF00, 0xFF12, 0xFF20, 0xFF30, 0xFF31};
+        if (below(16) == 0)
+            return devices[below(5)];
+        return uint16_t(DATA + below(256));
+    }
+};
@@ -12,9 +12,15 @@
  *       - 0xFF10: TX_STR_ADDR (write address of zero-terminated string)
  *       - 0xFF12: TX_INT (write 16-bit integer as decimal + newline)
  *       - 0xFF20: TIMER (read-only, returns cycles & 0xFFFF)
+ *       - 0xFF30: CORE_ID (read-only, index of the reading core)
+ *       - 0xFF31: CORE_COUNT (read-only, number of cores sharing memory)
+ *       - 0xFF40: REGION_BEGIN (write a region id, e.g. a label address)
+ *       - 0xFF41: REGION_END (write the id of the region being closed)
  *
  * Conventions
  *   • Stack grows downward. On reset, SP = 0xF000 (kept below MMIO window).
+ *     In multi-core setups core N starts at 0xF000 - N * CORE_STACK_SIZE.
+ *   • CAS/FADD are atomic with respect to other cores sharing the Memory.
  *   • CALL pushes the return address, RET pops it back into PC.
  *   • All GPRs are caller-saved in sample programs.
  *
@@ -24,7 +30,10 @@
  *   3) MMIO implementation ............................................ [MMIO]
  *   4) Memory wrapper (RAM + MMIO) .................................. [Memory]
  *   5) ALU operations and flag logic ................................... [ALU]
- *   6) Emu16 CPU core: reset/load/fetch/execute loop .................. [Emu16]
+ *   6) Saved machine state for snapshot/restore .................... [Snapshot]
+ *   7) Why a bounded run returned ................................ [StopReason]
+ *   8) Execution observers for profilers and models .................. [Probe]
+ *   9) Emu16 CPU core: reset/load/fetch/execute loop .................. [Emu16]
  *
  * Tip: enable trace mode in the frontend to print per-instruction state.
  *      (frontend parses --trace and calls Emu16 with trace=true)
@@ -33,6 +42,7 @@
  * Logic is preserved; only comments/whitespace were adjusted for clarity.
  */
 
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 #include <iostream>
@@ -41,8 +51,27 @@
 #include <string>
 #include <cassert>
 #include <functional>
+#include <map>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <stdint.h>
 
+// The instruction body is too big for the compiler to inline on its own, but
+// a call per guest instruction costs the plain loop about a fifth of its
+// speed, so run_slice() forces it in.
+#if defined(_MSC_VER)
+#define EMU16_ALWAYS_INLINE __forceinline
+#else
+#define EMU16_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+// Bump whenever architectural behaviour changes: it is part of every result
+// cache key, so old cached runs stop matching.
+#define EMU16_VERSION "emu16-1.2"
+
 // [ISA] Instruction set opcodes used by the decoder and encoder
 namespace ISA
 {
@@ -78,7 +107,43 @@ namespace ISA
         ADDI = 0x1B,
         SUBI = 0x1C,
         MUL = 0x1D,
+        CAS = 0x1E,
+        FADD = 0x1F,
     };
+
+    // Enum spelling of an opcode ("LD_ABS", "NOT"), for reports
+    static inline const char *name(uint16_t op)
+    {
+        static const char *names[32] = {
+            "NOP", "MOV", "ADD", "SUB", "AND", "OR", "XOR", "NOT",
+            "SHL", "SHR", "CMP", "PUSH", "POP", "LD_ABS", "ST_ABS", "LDI",
+            "JMP", "JZ", "JNZ", "JC", "JN", "CALL", "RET", "HALT",
+            "LD_IND", "ST_IND", "LEA", "ADDI", "SUBI", "MUL", "CAS", "FADD"};
+        return names[op & 0x1F];
+    }
+
+    // Instruction length in words: opcodes with an address/immediate take two
+    static inline unsigned words(uint16_t op)
+    {
+        switch (op & 0x1F)
+        {
+        case LD_ABS:
+        case ST_ABS:
+        case LDI:
+        case JMP:
+        case JZ:
+        case JNZ:
+        case JC:
+        case JN:
+        case CALL:
+        case LEA:
+        case ADDI:
+        case SUBI:
+            return 2;
+        default:
+            return 1;
+        }
+    }
 }
 
 // [Flags] Processor status flags: Negative, Zero, Carry, Overflow
@@ -98,14 +163,28 @@ static inline std::string flags_str(const Flags &f)
 // [MMIO] Minimal memory-mapped I/O devices per the map above
 struct MMIO
 {
+    // Console sink for TX_CHAR/TX_STR_ADDR/TX_INT. nullptr discards output
+    // (used by the fuzzer, which runs guests hundreds of thousands of times).
+    std::ostream *out = &std::cout;
+
+    // Guest accesses per MMIO word (index = addr & 0xFF), for run statistics.
+    // Relaxed atomics: threaded cores read devices without taking the lock.
+    std::atomic<uint64_t> reads[256] = {};
+    std::atomic<uint64_t> writes[256] = {};
+    // Bytes the console devices produced (counted even when out is null).
+    std::atomic<uint64_t> console_bytes{0};
+
     void write(uint16_t addr, uint16_t value)
     {
+        writes[addr & 0xFF].fetch_add(1, std::memory_order_relaxed);
         switch (addr)
         {
         case 0xFF00:
         {
             char c = char(value & 0xFF);
-            std::cout << c << std::flush;
+            console_bytes.fetch_add(1, std::memory_order_relaxed);
+            if (out)
+                *out << c << std::flush;
         }
         break;
         case 0xFF10:
@@ -116,19 +195,27 @@ struct MMIO
         break;
         case 0xFF12:
         {
-            std::cout << (value) << "\n";
+            std::string text = std::to_string(value) + "\n";
+            console_bytes.fetch_add(text.size(), std::memory_order_relaxed);
+            if (out)
+                *out << text;
         }
         break;
         default:
             break;
         }
     }
-    uint16_t read(uint16_t addr, uint64_t cycles, const std::function<uint16_t(uint16_t)> &mem_read)
+    uint16_t read(uint16_t addr, uint64_t cycles, uint16_t core, const std::function<uint16_t(uint16_t)> &mem_read)
     {
+        reads[addr & 0xFF].fetch_add(1, std::memory_order_relaxed);
         if (addr == 0xFF20)
         {
             return static_cast<uint16_t>(cycles & 0xFFFF);
         }
+        if (addr == 0xFF30)
+            return core;
+        if (addr == 0xFF31)
+            return core_count;
         return 0;
     }
     void service_pending(const std::function<uint16_t(uint16_t)> &mem_read)
@@ -142,37 +229,137 @@ struct MMIO
                 uint8_t b = uint8_t(w & 0xFF);
                 if (b == 0)
                     break;
-                std::cout << char(b);
+                console_bytes.fetch_add(1, std::memory_order_relaxed);
+                if (out)
+                    *out << char(b);
             }
-            std::cout.flush();
+            if (out)
+                out->flush();
             trigger_string_print = false;
         }
     }
     uint16_t pending_string_addr = 0;
     bool trigger_string_print = false;
+    uint16_t core_count = 1;
 };
 
 // [Memory] 64K-word RAM plus MMIO window at 0xFF00..0xFFFF
 struct Memory
 {
+    // Dirty tracking works on 256-word pages so a snapshot restore only has
+    // to copy back what the guest actually touched.
+    static constexpr uint32_t PAGE_SHIFT = 8;
+    static constexpr uint32_t PAGE_COUNT = 65536 >> PAGE_SHIFT;
+
     std::vector<uint16_t> mem;
     MMIO io;
+    bool track_dirty = false;
+    uint8_t dirty[PAGE_COUNT] = {0};
+
+    // While several cores run on host threads (set_shared), RAM lives in
+    // `ram` and every guest access is a relaxed atomic on it; CAS/FADD are
+    // real atomic RMWs and only the MMIO devices are serialized by `lock`.
+    // `mem` holds the image again once sharing ends.
+    bool shared = false;
+    std::unique_ptr<std::atomic<uint16_t>[]> ram;
+    std::mutex lock;
+
     Memory() : mem(65536, 0) {}
-    uint16_t read(uint16_t addr, uint64_t cycles)
+
+    // Dirty tracking is single-threaded, so sharing turns it off (a later
+    // snapshot restore then copies all of RAM).
+    void set_shared(bool on)
+    {
+        if (on == shared)
+            return;
+        if (on)
+        {
+            ram.reset(new std::atomic<uint16_t>[mem.size()]);
+            for (size_t i = 0; i < mem.size(); ++i)
+                ram[i].store(mem[i], std::memory_order_relaxed);
+            track_dirty = false;
+        }
+        else
+        {
+            for (size_t i = 0; i < mem.size(); ++i)
+                mem[i] = ram[i].load(std::memory_order_relaxed);
+            ram.reset();
+        }
+        shared = on;
+    }
+
+    // Plain RAM word access, no MMIO decode
+    inline uint16_t load(uint16_t addr) const
+    {
+        return shared ? ram[addr].load(std::memory_order_relaxed) : mem[addr];
+    }
+    inline void store(uint16_t addr, uint16_t value)
+    {
+        if (shared)
+            ram[addr].store(value, std::memory_order_relaxed);
+        else
+            mem[addr] = value;
+    }
+
+    uint16_t read(uint16_t addr, uint64_t cycles, uint16_t core = 0)
     {
         if (addr >= 0xFF00)
-            return io.read(addr, cycles, [&](uint16_t a)
-                           { return mem[a]; });
-        return mem[addr];
+            return io.read(addr, cycles, core, [&](uint16_t a)
+                           { return load(a); });
+        return load(addr);
     }
     void write(uint16_t addr, uint16_t value)
     {
         if (addr >= 0xFF00)
         {
+            std::unique_lock<std::mutex> g(lock, std::defer_lock);
+            if (shared)
+                g.lock();
             io.write(addr, value);
+            io.service_pending([&](uint16_t a)
+                               { return load(a); });
             return;
         }
-        mem[addr] = value;
+        store(addr, value);
+        if (track_dirty)
+            dirty[addr >> PAGE_SHIFT] = 1;
+    }
+    // Raw RAM store that bypasses MMIO decode (host-side patching of guest
+    // memory) but still keeps the dirty map honest.
+    void poke(uint16_t addr, uint16_t value)
+    {
+        store(addr, value);
+        if (track_dirty)
+            dirty[addr >> PAGE_SHIFT] = 1;
+    }
+    void clear_dirty()
+    {
+        std::memset(dirty, 0, sizeof(dirty));
+    }
+
+    // Atomic compare-and-swap: returns the old value, stores `desired` only
+    // if it equalled `expected`.
+    uint16_t cas(uint16_t addr, uint16_t expected, uint16_t desired, uint64_t cycles, uint16_t core)
+    {
+        if (shared && addr < 0xFF00)
+        {
+            uint16_t old = expected;
+            ram[addr].compare_exchange_strong(old, desired, std::memory_order_acq_rel, std::memory_order_acquire);
+            return old;
+        }
+        uint16_t old = read(addr, cycles, core);
+        if (old == expected)
+            write(addr, desired);
+        return old;
+    }
+    // Atomic fetch-and-add: returns the old value, stores old + delta.
+    uint16_t fetch_add(uint16_t addr, uint16_t delta, uint64_t cycles, uint16_t core)
+    {
+        if (shared && addr < 0xFF00)
+            return ram[addr].fetch_add(delta, std::memory_order_acq_rel);
+        uint16_t old = read(addr, cycles, core);
+        write(addr, uint16_t(old + delta));
+        return old;
     }
 };
 
@@ -269,11 +456,137 @@ struct ALU
 };
 
 
+// [Snapshot] Architectural state + RAM image captured by Emu16::snapshot()
+struct Snapshot
+{
+    uint16_t R[8] = {0};
+    uint16_t PC = 0;
+    Flags F{};
+    bool halted = false;
+    bool faulted = false;
+    uint64_t cycles = 0;
+    uint64_t retired = 0;
+    std::vector<uint16_t> mem;
+    uint64_t id = 0;
+};
+
+// [StopReason] Why run_for()/run_until() returned control to the caller
+enum class StopReason
+{
+    Halted,      // HALT executed
+    Fault,       // unknown opcode (core is halted too)
+    Budget,      // cycle budget used up; call again to resume
+    Deadline,    // host-time deadline passed; call again to resume
+    Breakpoint,  // PC reached a breakpoint (the instruction has not run yet)
+    DeviceEvent, // guest stored to MMIO while stop_on_device was set
+};
+
+static inline const char *stop_reason_name(StopReason r)
+{
+    switch (r)
+    {
+    case StopReason::Halted:
+        return "halted";
+    case StopReason::Fault:
+        return "fault";
+    case StopReason::Budget:
+        return "budget";
+    case StopReason::Deadline:
+        return "deadline";
+    case StopReason::Breakpoint:
+        return "breakpoint";
+    case StopReason::DeviceEvent:
+        return "device";
+    }
+    return "?";
+}
+
+struct Emu16;
+
+// Control transfers reported to probes
+enum class Flow
+{
+    Jump,   // JMP
+    Branch, // JZ/JNZ/JC/JN, taken or not
+    Call,   // CALL (target = callee)
+    Ret,    // RET (target = return address popped)
+};
+
+// [CallRet] CALL/RET matching shared by the core's shadow call stack and the
+// call-graph and timeline probes. A CALL pushes a frame that returns to
+// CALL + 2; a RET unwinds to the frame whose return address it jumps to.
+// Probes note() the transfer in on_flow() and apply it in on_retire().
+struct CallRet
+{
+    Flow pending = Flow::Jump; // Call or Ret waiting; Jump = nothing to apply
+    uint16_t func = 0;         // callee of a pending CALL
+    uint16_t ret = 0;          // address a pending CALL returns to / RET jumps to
+
+    void note(Flow kind, uint16_t pc, uint16_t target)
+    {
+        if (kind == Flow::Call)
+        {
+            pending = Flow::Call;
+            func = target;
+            ret = uint16_t(pc + 2);
+        }
+        else if (kind == Flow::Ret)
+        {
+            pending = Flow::Ret;
+            ret = target;
+        }
+    }
+
+    // Stack depth after a RET to `ra`: the innermost frame at or above
+    // `floor` whose return address is `ra` is popped with everything above
+    // it. Anything else (hand-made returns, untracked depth) pops one frame.
+    template <typename RetAt>
+    static size_t unwind_to(size_t depth, size_t floor, uint16_t ra, RetAt ret_at)
+    {
+        for (size_t i = depth; i-- > floor;)
+        {
+            if (ret_at(i) == ra)
+                return i;
+        }
+        return depth ? depth - 1 : 0;
+    }
+};
+
+// [Probe] Observer attached with Emu16::attach(). While any probe is attached
+// the core runs a separate probed loop; the plain loop never pays for them.
+struct Probe
+{
+    virtual ~Probe() = default;
+    // During a JMP/Jcc/CALL/RET, before on_retire for the same instruction.
+    virtual void on_flow(Emu16 &cpu, Flow kind, uint16_t pc, uint16_t target, bool taken) {}
+    // Every guest store (ST, PUSH, CALL, successful CAS, FADD), same timing.
+    virtual void on_store(Emu16 &cpu, uint16_t addr, uint16_t value) {}
+    // Every guest data load (LD, POP, RET, CAS, FADD), same timing.
+    virtual void on_load(Emu16 &cpu, uint16_t addr, uint16_t value) {}
+    // After each instruction: its address, first word, and cycles at start.
+    virtual void on_retire(Emu16 &cpu, uint16_t pc, uint16_t inst, uint64_t cycles_before) {}
+};
+
+// Observes nothing; attaching it selects the probed loop, the floor cost of
+// any profiler (bench16's and cosim16's `probed` engines).
+struct NullProbe : Probe
+{
+};
+
 // [Emu16] CPU core: registers, PC/FLAGS, fetch/decode/execute loop
 struct Emu16
 {
+    using Clock = std::chrono::steady_clock;
+
+    // run_until() looks at the host clock once per this many guest cycles.
+    static constexpr uint64_t DEADLINE_POLL_CYCLES = 1u << 16;
+
+    static constexpr uint16_t CORE_STACK_SIZE = 0x0400;
+
     bool trace = false;
-    Memory mem;
+    std::unique_ptr<Memory> own_mem; // null when attached to a shared Memory
+    Memory &mem;
+    uint16_t core_id = 0;
 
     // General purpose registers, where R7 is SP.
     uint16_t R[8] = {0};
@@ -281,9 +594,91 @@ struct Emu16
     uint16_t PC = 0;
     Flags F{};
     bool halted = false;
+    bool faulted = false; // halted on an unknown opcode
+    bool report_faults = true;
     uint64_t cycles = 0;
+    uint64_t retired = 0; // instructions executed since reset()
+
+    // Lowest SP reached by PUSH/CALL since reset(), and SP at reset; their
+    // difference is the peak stack depth in words.
+    uint16_t sp_low = 0;
+    uint16_t sp_top = 0;
+
+    // Edge coverage for fuzzing. When cov_map is set, every control transfer
+    // (taken or not) bumps an AFL-style slot hashed from the previous and the
+    // current block address. COV_MAP_SIZE must be a power of two.
+    static constexpr uint32_t COV_MAP_SIZE = 1u << 14;
+    uint8_t *cov_map = nullptr;
+    uint16_t cov_prev = 0;
+
+    // Bounded execution. The inner loop compares cycles against a budget
+    // held in a local; anything that must end the slice early (HALT, fault,
+    // breakpoint, device event) goes through stop_now(), and the instruction
+    // body also reports it through its return value so the loop never has
+    // to re-read this state per instruction.
+    bool stop_on_device = false;
+    bool stop_requested = false;
+    StopReason pending = StopReason::Budget;
+    std::vector<uint8_t> breakpoints; // 64K flags, allocated on first use
+    uint32_t breakpoint_count = 0;
+    // PC of the breakpoint the last slice stopped on, or -1. Only that
+    // breakpoint is stepped over when the next slice starts there.
+    int32_t resume_bp_pc = -1;
+
+    std::vector<Probe *> probes;
+    // Address of the instruction being executed, stored only by the
+    // instrumented body (probes, coverage, shadow call stack). Atomic
+    // (relaxed, a plain store) so the sampling profiler's signal handler
+    // may read it.
+    std::atomic<uint16_t> cur_pc{0};
+    uint16_t cur_inst = 0; // first word of that instruction (probed loop only)
+
+    // Shadow call stack for the sampling profiler, kept by flow() only while
+    // shadow_calls is set. A signal handler on this thread may read it:
+    // entries are written before shadow_depth publishes them. Frames deeper
+    // than SHADOW_MAX are counted but not stored.
+    static constexpr uint32_t SHADOW_MAX = 64;
+    bool shadow_calls = false;
+    uint16_t shadow_func[SHADOW_MAX];
+    uint16_t shadow_ret[SHADOW_MAX];
+    std::atomic<uint32_t> shadow_depth{0};
+
+    // Guest-marked regions: a store to REGION_BEGIN opens region `id`, one to
+    // REGION_END closes the innermost open region with that id. Cycles and
+    // instructions between the two stores are added to the region; a region
+    // re-entered while already open (recursion) is only timed at the outer
+    // level. Kept per core, always on; see Regions.cpp for the report.
+    // At most MAX_OPEN_REGIONS are open at once; further begins are only
+    // counted, so a guest that never ends its regions can't grow the stack.
+    static constexpr uint16_t REGION_BEGIN = 0xFF40;
+    static constexpr uint16_t REGION_END = 0xFF41;
+    static constexpr size_t MAX_OPEN_REGIONS = 64;
+    struct RegionCount
+    {
+        uint64_t invocations = 0, cycles = 0, instructions = 0;
+    };
+    struct OpenRegion
+    {
+        uint16_t id;
+        uint64_t cycles, retired;
+    };
+    std::map<uint16_t, RegionCount> regions;
+    std::vector<OpenRegion> open_regions;
+    uint64_t region_unmatched = 0; // REGION_END with no matching begin
+    uint64_t region_overflow = 0;  // REGION_BEGIN dropped at MAX_OPEN_REGIONS
 
-    Emu16(bool trace_) : trace(trace_) {}
+    // Flight recorder: the last FLIGHT_SIZE taken jumps, branches, calls and
+    // returns, always on. Each is one packed word, cycles (low 32 bits) |
+    // from | to, i.e. a single store per taken transfer; the kind is decoded
+    // from the opcode at `from` when dumping. Printed with the fault report;
+    // frontends call dump_flight() on other stops.
+    static constexpr uint32_t FLIGHT_SIZE = 256; // power of two
+    uint64_t flight[FLIGHT_SIZE];
+    uint64_t flight_count = 0;                         // transfers recorded so far
+    std::function<std::string(uint16_t)> flight_names; // optional symbolizer
+
+    Emu16(bool trace_) : trace(trace_), own_mem(new Memory()), mem(*own_mem) {}
+    Emu16(bool trace_, Memory &shared, uint16_t core_id_) : trace(trace_), mem(shared), core_id(core_id_) {}
 
     void reset()
     {
@@ -292,8 +687,67 @@ struct Emu16
         PC = 0;
         F = Flags{};
         halted = false;
+        faulted = false;
         cycles = 0;
-        R[7] = 0xF000; // SP below MMIO (0xFF00..0xFFFF)
+        retired = 0;
+        clear_regions();
+        cov_prev = 0;
+        flight_count = 0;
+        shadow_depth.store(0, std::memory_order_relaxed);
+        resume_bp_pc = -1;
+        R[7] = uint16_t(0xF000 - core_id * CORE_STACK_SIZE); // SP below MMIO (0xFF00..0xFFFF)
+        sp_low = sp_top = R[7];
+    }
+
+    // Capture registers + RAM. Starts a new dirty-tracking epoch, so a later
+    // restore() of this snapshot only copies back the pages written since.
+    Snapshot snapshot()
+    {
+        static std::atomic<uint64_t> next_id{0};
+        Snapshot s;
+        for (int i = 0; i < 8; i++)
+            s.R[i] = R[i];
+        s.PC = PC;
+        s.F = F;
+        s.halted = halted;
+        s.faulted = faulted;
+        s.cycles = cycles;
+        s.retired = retired;
+        s.mem = mem.mem;
+        s.id = ++next_id;
+        mem.clear_dirty();
+        dirty_base = s.id;
+        return s;
+    }
+    // Region counts are not part of the snapshot and restart empty.
+    void restore(const Snapshot &s)
+    {
+        for (int i = 0; i < 8; i++)
+            R[i] = s.R[i];
+        PC = s.PC;
+        F = s.F;
+        halted = s.halted;
+        faulted = s.faulted;
+        cycles = s.cycles;
+        retired = s.retired;
+        clear_regions();
+        cov_prev = 0;
+        resume_bp_pc = -1;
+        if (mem.track_dirty && dirty_base == s.id)
+        {
+            const uint32_t page = 1u << Memory::PAGE_SHIFT;
+            for (uint32_t p = 0; p < Memory::PAGE_COUNT; ++p)
+            {
+                if (mem.dirty[p])
+                    std::memcpy(&mem.mem[p * page], &s.mem[p * page], page * sizeof(uint16_t));
+            }
+        }
+        else
+        {
+            mem.mem = s.mem;
+        }
+        mem.clear_dirty();
+        dirty_base = s.id;
     }
     void load(const std::vector<uint16_t> &image, uint16_t base)
     {
@@ -307,7 +761,7 @@ struct Emu16
 
     inline uint16_t fetch()
     {
-        uint16_t w = mem.read(PC, cycles);
+        uint16_t w = mem.read(PC, cycles, core_id);
         if (trace)
         {
             std::cout << "[FETCH] PC=" << hex4(PC) << " W=" << hex4(w) << "\n";
@@ -323,273 +777,580 @@ struct Emu16
         return oss.str();
     }
 
+    // Run to HALT, ignoring breakpoints and device events.
     void run()
     {
         while (!halted)
+            run_for(UINT64_MAX);
+    }
+
+    // Run for at most max_cycles more cycles (the last instruction may finish
+    // a cycle or two past the budget). Resumable: call again to continue.
+    StopReason run_for(uint64_t max_cycles)
+    {
+        uint64_t end = (max_cycles > UINT64_MAX - cycles) ? UINT64_MAX : cycles + max_cycles;
+        return run_slice(end, false, Clock::time_point());
+    }
+    // Run until the host clock passes `deadline` (polled every
+    // DEADLINE_POLL_CYCLES guest cycles) or another stop condition hits.
+    StopReason run_until(Clock::time_point deadline)
+    {
+        return run_slice(UINT64_MAX, true, deadline);
+    }
+
+    void set_breakpoint(uint16_t addr, bool on = true)
+    {
+        if (breakpoints.empty())
+            breakpoints.assign(65536, 0);
+        if (breakpoints[addr] != uint8_t(on))
+            breakpoint_count += on ? 1 : uint32_t(-1);
+        breakpoints[addr] = uint8_t(on);
+    }
+
+    void attach(Probe *p)
+    {
+        probes.push_back(p);
+    }
+    void detach(Probe *p)
+    {
+        for (size_t i = 0; i < probes.size(); ++i)
         {
-            uint16_t inst = fetch();
-            uint16_t opcode = (inst >> 11) & 0x1F;
-            uint16_t rd = (inst >> 8) & 0x7;
-            uint16_t rs = (inst >> 5) & 0x7;
-            switch (opcode)
+            if (probes[i] == p)
             {
-            case ISA::NOP:
-                break;
-            case ISA::MOV:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] MOV r" << rd << ", r" << rs << "\n";
-                write_reg(rd, R[rs]);
-            }
-            break;
-            case ISA::ADD:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] ADD r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::add(R[rd], R[rs], F));
-            }
-            break;
-            case ISA::SUB:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] SUB r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::sub(R[rd], R[rs], F));
-            }
-            break;
-            case ISA::AND:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] AND r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::band(R[rd], R[rs], F));
-            }
-            break;
-            case ISA::OR:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] OR r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::bor(R[rd], R[rs], F));
-            }
-            break;
-            case ISA::XOR:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] XOR r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::bxor(R[rd], R[rs], F));
-            }
-            break;
-            case ISA::NOT_:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] NOT r" << rd << "\n";
-                write_reg(rd, ALU::bnot(R[rd], F));
-            }
-            break;
-            case ISA::SHL:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] SHL r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::shl(R[rd], R[rs], F));
-            }
-            break;
-            case ISA::SHR:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] SHR r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::shr(R[rd], R[rs], F));
-            }
-            break;
-            case ISA::CMP:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] CMP r" << rd << ", r" << rs << "\n";
-                (void)ALU::sub(R[rd], R[rs], F);
-            }
-            break;
-            case ISA::PUSH:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] PUSH r" << rs << "\n";
-                R[7] -= 1;
-                mem.write(R[7], R[rs]);
-                cycles++;
-                if (trace)
-                    std::cout << "  [WRITE] [SP=" << hex4(R[7]) << "] = " << hex4(R[rs]) << "\n";
-            }
-            break;
-            case ISA::POP:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] POP r" << rd << "\n";
-                uint16_t v = mem.read(R[7], cycles);
-                write_reg(rd, v);
-                R[7] += 1;
-                cycles++;
-            }
-            break;
-            case ISA::LD_ABS:
-            {
-                uint16_t addr = fetch();
-                uint16_t v = (addr >= 0xFF00) ? mem.io.read(addr, cycles, [&](uint16_t a)
-                                                            { return mem.mem[a]; })
-                                              : mem.read(addr, cycles);
-                if (trace)
-                    std::cout << "  [EXEC] LD r" << rd << ", [" << hex4(addr) << "] -> " << hex4(v) << "\n";
-                write_reg(rd, v);
-            }
-            break;
-            case ISA::ST_ABS:
-            {
-                uint16_t addr = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] ST r" << rs << ", [" << hex4(addr) << "] = " << hex4(R[rs]) << "\n";
-                mem.write(addr, R[rs]);
-                cycles++;
-            }
-            break;
-            case ISA::LDI:
-            {
-                uint16_t imm = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] LDI r" << rd << ", " << hex4(imm) << "\n";
-                write_reg(rd, imm);
+                probes.erase(probes.begin() + long(i));
+                return;
             }
+        }
+    }
+
+    // End the current run_for()/run_until() slice after this instruction.
+    inline void stop_now(StopReason r)
+    {
+        resume_bp_pc = r == StopReason::Breakpoint ? int32_t(PC) : -1;
+        pending = r;
+        stop_requested = true;
+    }
+
+    // Edge coverage and the shadow call stack are kept by the instrumented
+    // instruction body (step_impl<true>), like probes; the plain body only
+    // keeps the flight recorder.
+    bool instrumented() const
+    {
+        return cov_map || shadow_calls;
+    }
+
+    // Execute exactly one instruction (plus any pending MMIO side effects),
+    // notifying attached probes. Returns true when it stopped the run (HALT,
+    // fault, device event); the reason is in `pending`.
+    bool step()
+    {
+        if (probes.empty())
+            return instrumented() ? step_impl<true>() : step_impl<false>();
+        uint16_t pc0 = PC;
+        uint64_t c0 = cycles;
+        bool stop = step_impl<true>();
+        for (Probe *p : probes)
+            p->on_retire(*this, pc0, cur_inst, c0);
+        return stop;
+    }
+
+    template <bool Probed>
+    EMU16_ALWAYS_INLINE bool step_impl()
+    {
+        const uint16_t pc0 = PC;
+        bool stop = false;
+        if (Probed)
+            cur_pc.store(pc0, std::memory_order_relaxed);
+        retired++;
+        uint16_t inst = fetch();
+        if (Probed)
+            cur_inst = inst;
+        uint16_t opcode = (inst >> 11) & 0x1F;
+        uint16_t rd = (inst >> 8) & 0x7;
+        uint16_t rs = (inst >> 5) & 0x7;
+        switch (opcode)
+        {
+        case ISA::NOP:
             break;
-            case ISA::JMP:
-            {
-                uint16_t addr = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] JMP " << hex4(addr) << "\n";
+        case ISA::MOV:
+        {
+            if (trace)
+                std::cout << "  [EXEC] MOV r" << rd << ", r" << rs << "\n";
+            write_reg(rd, R[rs]);
+        }
+        break;
+        case ISA::ADD:
+        {
+            if (trace)
+                std::cout << "  [EXEC] ADD r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::add(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::SUB:
+        {
+            if (trace)
+                std::cout << "  [EXEC] SUB r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::sub(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::AND:
+        {
+            if (trace)
+                std::cout << "  [EXEC] AND r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::band(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::OR:
+        {
+            if (trace)
+                std::cout << "  [EXEC] OR r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::bor(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::XOR:
+        {
+            if (trace)
+                std::cout << "  [EXEC] XOR r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::bxor(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::NOT_:
+        {
+            if (trace)
+                std::cout << "  [EXEC] NOT r" << rd << "\n";
+            write_reg(rd, ALU::bnot(R[rd], F));
+        }
+        break;
+        case ISA::SHL:
+        {
+            if (trace)
+                std::cout << "  [EXEC] SHL r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::shl(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::SHR:
+        {
+            if (trace)
+                std::cout << "  [EXEC] SHR r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::shr(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::CMP:
+        {
+            if (trace)
+                std::cout << "  [EXEC] CMP r" << rd << ", r" << rs << "\n";
+            (void)ALU::sub(R[rd], R[rs], F);
+        }
+        break;
+        case ISA::PUSH:
+        {
+            if (trace)
+                std::cout << "  [EXEC] PUSH r" << rs << "\n";
+            R[7] -= 1;
+            sp_low = std::min(sp_low, R[7]);
+            stop = store<Probed>(R[7], R[rs]);
+            cycles++;
+            if (trace)
+                std::cout << "  [WRITE] [SP=" << hex4(R[7]) << "] = " << hex4(R[rs]) << "\n";
+        }
+        break;
+        case ISA::POP:
+        {
+            if (trace)
+                std::cout << "  [EXEC] POP r" << rd << "\n";
+            uint16_t v = mem.read(R[7], cycles, core_id);
+            if (Probed)
+                notify_load(R[7], v);
+            write_reg(rd, v);
+            R[7] += 1;
+            cycles++;
+        }
+        break;
+        case ISA::LD_ABS:
+        {
+            uint16_t addr = fetch();
+            uint16_t v = (addr >= 0xFF00) ? mem.io.read(addr, cycles, core_id, [&](uint16_t a)
+                                                        { return mem.load(a); })
+                                          : mem.read(addr, cycles, core_id);
+            if (Probed)
+                notify_load(addr, v);
+            if (trace)
+                std::cout << "  [EXEC] LD r" << rd << ", [" << hex4(addr) << "] -> " << hex4(v) << "\n";
+            write_reg(rd, v);
+        }
+        break;
+        case ISA::ST_ABS:
+        {
+            uint16_t addr = fetch();
+            if (trace)
+                std::cout << "  [EXEC] ST r" << rs << ", [" << hex4(addr) << "] = " << hex4(R[rs]) << "\n";
+            stop = store<Probed>(addr, R[rs]);
+            cycles++;
+        }
+        break;
+        case ISA::LDI:
+        {
+            uint16_t imm = fetch();
+            if (trace)
+                std::cout << "  [EXEC] LDI r" << rd << ", " << hex4(imm) << "\n";
+            write_reg(rd, imm);
+        }
+        break;
+        case ISA::JMP:
+        {
+            uint16_t addr = fetch();
+            if (trace)
+                std::cout << "  [EXEC] JMP " << hex4(addr) << "\n";
+            PC = addr;
+            flow<Probed>(Flow::Jump, pc0, addr, true);
+        }
+        break;
+        case ISA::JZ:
+        {
+            uint16_t addr = fetch();
+            if (trace)
+                std::cout << "  [EXEC] JZ " << hex4(addr) << " (Z=" << F.Z << ")\n";
+            bool taken = F.Z;
+            if (taken)
                 PC = addr;
-            }
-            break;
-            case ISA::JZ:
-            {
-                uint16_t addr = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] JZ " << hex4(addr) << " (Z=" << F.Z << ")\n";
-                if (F.Z)
-                    PC = addr;
-            }
-            break;
-            case ISA::JNZ:
-            {
-                uint16_t addr = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] JNZ " << hex4(addr) << " (Z=" << F.Z << ")\n";
-                if (!F.Z)
-                    PC = addr;
-            }
-            break;
-            case ISA::JC:
-            {
-                uint16_t addr = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] JC " << hex4(addr) << " (C=" << F.C << ")\n";
-                if (F.C)
-                    PC = addr;
-            }
-            break;
-            case ISA::JN:
-            {
-                uint16_t addr = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] JN " << hex4(addr) << " (N=" << F.N << ")\n";
-                if (F.N)
-                    PC = addr;
-            }
-            break;
-            case ISA::CALL:
-            {
-                uint16_t addr = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] CALL " << hex4(addr) << " (push RA=" << hex4(PC) << ")\n";
-                R[7] -= 1;
-                mem.write(R[7], PC);
+            flow<Probed>(Flow::Branch, pc0, addr, taken);
+        }
+        break;
+        case ISA::JNZ:
+        {
+            uint16_t addr = fetch();
+            if (trace)
+                std::cout << "  [EXEC] JNZ " << hex4(addr) << " (Z=" << F.Z << ")\n";
+            bool taken = !F.Z;
+            if (taken)
                 PC = addr;
-                cycles++;
-            }
-            break;
-            case ISA::RET:
-            {
-                uint16_t ra = mem.read(R[7], cycles);
-                R[7] += 1;
-                if (trace)
-                    std::cout << "  [EXEC] RET -> " << hex4(ra) << "\n";
-                PC = ra;
-                cycles++;
-            }
-            break;
-            case ISA::HALT:
-            {
-                if (trace)
-                    std::cout << "  [EXEC] HALT\n";
-                halted = true;
-            }
-            break;
-            case ISA::LD_IND:
-            {
-                uint16_t addr = R[rs];
-                uint16_t v = mem.read(addr, cycles);
-                if (trace)
-                    std::cout << "  [EXEC] LD r" << rd << ", [r" << rs << "=" << hex4(addr) << "] -> " << hex4(v) << "\n";
-                write_reg(rd, v);
-            }
-            break;
-            case ISA::ST_IND:
-            {
-                uint16_t addr = R[rd];
-                if (trace)
-                    std::cout << "  [EXEC] ST r" << rs << " -> [r" << rd << "=" << hex4(addr) << "] = " << hex4(R[rs]) << "\n";
-                mem.write(addr, R[rs]);
-                cycles++;
-            }
-            break;
-            case ISA::LEA:
-            {
-                uint16_t imm = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] LEA r" << rd << ", " << hex4(imm) << "\n";
-                write_reg(rd, imm);
-            }
-            break;
-            case ISA::ADDI:
-            {
-                uint16_t imm = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] ADDI r" << rd << ", " << hex4(imm) << "\n";
-                write_reg(rd, ALU::add(R[rd], imm, F));
-            }
-            break;
-            case ISA::SUBI:
-            {
-                uint16_t imm = fetch();
-                if (trace)
-                    std::cout << "  [EXEC] SUBI r" << rd << ", " << hex4(imm) << "\n";
-                write_reg(rd, ALU::sub(R[rd], imm, F));
-            }
-            break;
-            case ISA::MUL:
+            flow<Probed>(Flow::Branch, pc0, addr, taken);
+        }
+        break;
+        case ISA::JC:
+        {
+            uint16_t addr = fetch();
+            if (trace)
+                std::cout << "  [EXEC] JC " << hex4(addr) << " (C=" << F.C << ")\n";
+            bool taken = F.C;
+            if (taken)
+                PC = addr;
+            flow<Probed>(Flow::Branch, pc0, addr, taken);
+        }
+        break;
+        case ISA::JN:
+        {
+            uint16_t addr = fetch();
+            if (trace)
+                std::cout << "  [EXEC] JN " << hex4(addr) << " (N=" << F.N << ")\n";
+            bool taken = F.N;
+            if (taken)
+                PC = addr;
+            flow<Probed>(Flow::Branch, pc0, addr, taken);
+        }
+        break;
+        case ISA::CALL:
+        {
+            uint16_t addr = fetch();
+            if (trace)
+                std::cout << "  [EXEC] CALL " << hex4(addr) << " (push RA=" << hex4(PC) << ")\n";
+            R[7] -= 1;
+            sp_low = std::min(sp_low, R[7]);
+            stop = store<Probed>(R[7], PC);
+            PC = addr;
+            cycles++;
+            flow<Probed>(Flow::Call, pc0, addr, true);
+        }
+        break;
+        case ISA::RET:
+        {
+            uint16_t ra = mem.read(R[7], cycles, core_id);
+            if (Probed)
+                notify_load(R[7], ra);
+            R[7] += 1;
+            if (trace)
+                std::cout << "  [EXEC] RET -> " << hex4(ra) << "\n";
+            PC = ra;
+            cycles++;
+            flow<Probed>(Flow::Ret, pc0, ra, true);
+        }
+        break;
+        case ISA::HALT:
+        {
+            if (trace)
+                std::cout << "  [EXEC] HALT\n";
+            halted = true;
+            stop_now(StopReason::Halted);
+            stop = true;
+        }
+        break;
+        case ISA::LD_IND:
+        {
+            uint16_t addr = R[rs];
+            uint16_t v = mem.read(addr, cycles, core_id);
+            if (Probed)
+                notify_load(addr, v);
+            if (trace)
+                std::cout << "  [EXEC] LD r" << rd << ", [r" << rs << "=" << hex4(addr) << "] -> " << hex4(v) << "\n";
+            write_reg(rd, v);
+        }
+        break;
+        case ISA::ST_IND:
+        {
+            uint16_t addr = R[rd];
+            if (trace)
+                std::cout << "  [EXEC] ST r" << rs << " -> [r" << rd << "=" << hex4(addr) << "] = " << hex4(R[rs]) << "\n";
+            stop = store<Probed>(addr, R[rs]);
+            cycles++;
+        }
+        break;
+        case ISA::LEA:
+        {
+            uint16_t imm = fetch();
+            if (trace)
+                std::cout << "  [EXEC] LEA r" << rd << ", " << hex4(imm) << "\n";
+            write_reg(rd, imm);
+        }
+        break;
+        case ISA::ADDI:
+        {
+            uint16_t imm = fetch();
+            if (trace)
+                std::cout << "  [EXEC] ADDI r" << rd << ", " << hex4(imm) << "\n";
+            write_reg(rd, ALU::add(R[rd], imm, F));
+        }
+        break;
+        case ISA::SUBI:
+        {
+            uint16_t imm = fetch();
+            if (trace)
+                std::cout << "  [EXEC] SUBI r" << rd << ", " << hex4(imm) << "\n";
+            write_reg(rd, ALU::sub(R[rd], imm, F));
+        }
+        break;
+        case ISA::MUL:
+        {
+            if (trace)
+                std::cout << "  [EXEC] MUL r" << rd << ", r" << rs << "\n";
+            write_reg(rd, ALU::mul(R[rd], R[rs], F));
+        }
+        break;
+        case ISA::CAS:
+        {
+            uint16_t ra = (inst >> 2) & 0x7;
+            uint16_t addr = R[ra];
+            uint16_t old = mem.cas(addr, R[rd], R[rs], cycles, core_id);
+            bool ok = (old == R[rd]);
+            if (Probed)
+                notify_load(addr, old);
+            if (Probed && ok)
+                notify_store(addr, R[rs]);
+            if (trace)
+                std::cout << "  [EXEC] CAS r" << rd << ", r" << rs << ", [r" << ra << "=" << hex4(addr) << "] -> " << hex4(old) << (ok ? " (swapped)" : " (failed)") << "\n";
+            write_reg(rd, old);
+            F.Z = ok; // Z reports success, not the loaded value
+            cycles++;
+        }
+        break;
+        case ISA::FADD:
+        {
+            uint16_t addr = R[rs];
+            uint16_t old = mem.fetch_add(addr, R[rd], cycles, core_id);
+            if (Probed)
             {
-                if (trace)
-                    std::cout << "  [EXEC] MUL r" << rd << ", r" << rs << "\n";
-                write_reg(rd, ALU::mul(R[rd], R[rs], F));
+                notify_load(addr, old);
+                notify_store(addr, uint16_t(old + R[rd]));
             }
-            break;
-            default:
+            if (trace)
+                std::cout << "  [EXEC] FADD r" << rd << ", [r" << rs << "=" << hex4(addr) << "] -> " << hex4(old) << "\n";
+            write_reg(rd, old);
+            cycles++;
+        }
+        break;
+        default:
+        {
+            if (report_faults)
             {
                 std::cerr << "Unknown opcode: " << opcode << " at " << hex4(PC - 1) << "\n";
-                halted = true;
+                dump_flight(std::cerr);
             }
-            break;
-            }
-            mem.io.service_pending([&](uint16_t a)
-                                   { return mem.mem[a]; });
-            if (trace)
+            halted = true;
+            faulted = true;
+            stop_now(StopReason::Fault);
+            stop = true;
+        }
+        break;
+        }
+        if (trace)
+        {
+            std::cout << "  [STATE] PC=" << hex4(PC) << " SP=" << hex4(R[7])
+                      << " R0=" << hex4(R[0]) << " R1=" << hex4(R[1])
+                      << " FLAGS=" << flags_str(F) << " CYC=" << cycles << "\n";
+        }
+        return stop;
+    }
+
+    // Returns true when a device store ended the slice (stop_on_device).
+    // RAM stores skip the MMIO decode entirely.
+    template <bool Probed>
+    inline bool store(uint16_t addr, uint16_t v)
+    {
+        bool stop = false;
+        if (addr >= 0xFF00)
+        {
+            mem.write(addr, v);
+            stop = device_store(addr, v);
+        }
+        else
+            mem.poke(addr, v);
+        if (Probed)
+            notify_store(addr, v);
+        return stop;
+    }
+
+    bool device_store(uint16_t addr, uint16_t v)
+    {
+        if (addr == REGION_BEGIN)
+        {
+            if (open_regions.size() < MAX_OPEN_REGIONS)
+                open_regions.push_back({v, cycles, retired});
+            else
+                region_overflow++;
+        }
+        else if (addr == REGION_END)
+            region_end(v);
+        if (!stop_on_device)
+            return false;
+        stop_now(StopReason::DeviceEvent);
+        return true;
+    }
+
+    void clear_regions()
+    {
+        regions.clear();
+        open_regions.clear();
+        region_unmatched = 0;
+        region_overflow = 0;
+    }
+
+    void region_end(uint16_t id)
+    {
+        size_t i = open_regions.size();
+        while (i > 0 && open_regions[i - 1].id != id)
+            --i;
+        if (i == 0)
+        {
+            region_unmatched++;
+            return;
+        }
+        OpenRegion o = open_regions[i - 1];
+        open_regions.resize(i - 1); // also drops regions left open inside it
+        RegionCount &r = regions[id];
+        r.invocations++;
+        for (const OpenRegion &outer : open_regions)
+            if (outer.id == id)
+                return;
+        r.cycles += cycles - o.cycles;
+        r.instructions += retired - o.retired;
+    }
+
+    void notify_store(uint16_t addr, uint16_t v)
+    {
+        for (Probe *p : probes)
+            p->on_store(*this, addr, v);
+    }
+
+    void notify_load(uint16_t addr, uint16_t v)
+    {
+        for (Probe *p : probes)
+            p->on_load(*this, addr, v);
+    }
+
+    // Most recent transfers last; at most `last` of them.
+    void dump_flight(std::ostream &o, size_t last = FLIGHT_SIZE) const
+    {
+        static const char *names[] = {"JMP", "JZ", "JNZ", "JC", "JN", "CALL", "RET"};
+        uint64_t n = std::min<uint64_t>(std::min<uint64_t>(flight_count, FLIGHT_SIZE), last);
+        // Rebuild full cycle stamps walking back from now; entries less than
+        // 2^32 cycles apart (always, in practice) are exact.
+        std::vector<uint64_t> stamp(n);
+        uint64_t hi = cycles;
+        for (uint64_t k = n; k-- > 0;)
+        {
+            uint64_t c = (hi & ~0xFFFFFFFFull) | (flight[(flight_count - n + k) & (FLIGHT_SIZE - 1)] >> 32);
+            if (c > hi)
+                c -= 1ull << 32;
+            stamp[k] = hi = c;
+        }
+        o << "=== flight recorder: last " << n << " of " << flight_count << " control transfers";
+        if (mem.io.core_count > 1)
+            o << " (core " << core_id << ")";
+        o << " ===\n";
+        for (uint64_t k = 0; k < n; ++k)
+        {
+            uint64_t e = flight[(flight_count - n + k) & (FLIGHT_SIZE - 1)];
+            uint16_t from = uint16_t(e >> 16), to = uint16_t(e);
+            uint16_t op = (mem.load(from) >> 11) & 0x1F;
+            const char *kind = (op >= ISA::JMP && op <= ISA::RET) ? names[op - ISA::JMP] : "?";
+            o << std::setw(14) << stamp[k] << "  " << std::left << std::setw(4) << kind << std::right
+              << "  " << hex4(from) << " -> " << hex4(to);
+            if (flight_names)
+                o << "  " << flight_names(from) << " -> " << flight_names(to);
+            o << "\n";
+        }
+    }
+
+    // `from` is the address of the transferring instruction. The plain loop
+    // pays for one flight recorder store per taken transfer and nothing else.
+    template <bool Probed>
+    inline void flow(Flow kind, uint16_t from, uint16_t target, bool taken)
+    {
+        if (taken)
+            flight[flight_count++ & (FLIGHT_SIZE - 1)] = (cycles << 32) | (uint32_t(from) << 16) | target;
+        if (Probed)
+        {
+            cov_edge(PC);
+            if (shadow_calls)
             {
-                std::cout << "  [STATE] PC=" << hex4(PC) << " SP=" << hex4(R[7])
-                          << " R0=" << hex4(R[0]) << " R1=" << hex4(R[1])
-                          << " FLAGS=" << flags_str(F) << " CYC=" << cycles << "\n";
+                if (kind == Flow::Call)
+                    shadow_push(target, uint16_t(from + 2));
+                else if (kind == Flow::Ret)
+                    shadow_pop(target);
             }
+            for (Probe *p : probes)
+                p->on_flow(*this, kind, from, target, taken);
+        }
+    }
+
+    void shadow_push(uint16_t func, uint16_t ret)
+    {
+        uint32_t d = shadow_depth.load(std::memory_order_relaxed);
+        if (d < SHADOW_MAX)
+        {
+            shadow_func[d] = func;
+            shadow_ret[d] = ret;
+        }
+        std::atomic_signal_fence(std::memory_order_release);
+        shadow_depth.store(d + 1, std::memory_order_relaxed);
+    }
+
+    // Past SHADOW_MAX the frames are not stored, so a RET pops one.
+    void shadow_pop(uint16_t ra)
+    {
+        uint32_t d = shadow_depth.load(std::memory_order_relaxed);
+        uint32_t to = d <= SHADOW_MAX ? uint32_t(CallRet::unwind_to(d, 0, ra, [&](size_t i)
+                                                                     { return shadow_ret[i]; }))
+                                      : d - 1;
+        shadow_depth.store(to, std::memory_order_relaxed);
+    }
+
+    inline void cov_edge(uint16_t to)
+    {
+        if (cov_map)
+        {
+            uint16_t cur = uint16_t((to * 40503u) & (COV_MAP_SIZE - 1));
+            cov_map[cur ^ cov_prev]++;
+            cov_prev = uint16_t(cur >> 1);
         }
     }
 
@@ -604,4 +1365,61 @@ struct Emu16
         }
         cycles++;
     }
+
+    uint64_t dirty_base = 0; // snapshot id the dirty map is relative to
+
+    StopReason run_slice(uint64_t budget_end, bool timed, Clock::time_point deadline)
+    {
+        if (halted)
+            return faulted ? StopReason::Fault : StopReason::Halted;
+        stop_requested = false;
+        for (;;)
+        {
+            uint64_t end = budget_end;
+            if (timed && budget_end - cycles > DEADLINE_POLL_CYCLES)
+                end = cycles + DEADLINE_POLL_CYCLES;
+            if (breakpoint_count == 0 && probes.empty())
+            {
+                if (instrumented())
+                {
+                    while (cycles < end)
+                        if (step_impl<true>())
+                            break;
+                }
+                else
+                {
+                    while (cycles < end)
+                        if (step_impl<false>())
+                            break;
+                }
+            }
+            else
+            {
+                // Resuming from a breakpoint stop executes that instruction;
+                // that is what makes breakpoints resumable. Any other slice
+                // stops on a breakpoint even at its first instruction.
+                while (cycles < end)
+                {
+                    if (breakpoint_count && breakpoints[PC] && int32_t(PC) != resume_bp_pc)
+                    {
+                        stop_now(StopReason::Breakpoint);
+                        break;
+                    }
+                    resume_bp_pc = -1;
+                    if (step())
+                        break;
+                }
+            }
+            if (stop_requested)
+            {
+                stop_requested = false;
+                return pending;
+            }
+            resume_bp_pc = -1;
+            if (cycles >= budget_end)
+                return StopReason::Budget;
+            if (timed && Clock::now() >= deadline)
+                return StopReason::Deadline;
+        }
+    }
 };
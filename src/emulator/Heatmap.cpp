@@ -0,0 +1,253 @@
+#pragma once
+
+/**
+ * Memory access heatmap (Heatmap.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --heatmap out.json` attaches this probe and counts, for every one of
+ * the 64K words, how often it was
+ *
+ *   • fetched as an instruction word (opcode or its address/immediate),
+ *   • read or written as data (LD, ST, CAS, FADD),
+ *   • read or written as stack (PUSH, POP, CALL, RET).
+ *
+ * The report prints a 16x16 page map per kind (one cell per 256-word page,
+ * shaded on a log scale), the hottest addresses, and the stride of every
+ * LD_IND/ST_IND site: its latest address step and how often each step
+ * repeated the one before, which is what a prefetcher or a data-layout
+ * change would exploit. Counts are flat arrays indexed by address; nothing
+ * is formatted until the run is over.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+#include "Symbols.cpp"
+
+struct Heatmap : Probe
+{
+    static constexpr uint32_t PAGE_WORDS = 256;
+
+    enum Kind
+    {
+        Fetch,
+        DataRead,
+        DataWrite,
+        StackRead,
+        StackWrite,
+        KINDS,
+    };
+
+    // A LD_IND/ST_IND instruction and the addresses it walked
+    struct StrideSite
+    {
+        uint64_t execs = 0;
+        uint64_t regular = 0; // steps equal to the step before them
+        uint16_t last = 0;
+        int32_t stride = 0;
+    };
+
+    std::vector<uint64_t> counts[KINDS];
+    std::map<uint16_t, StrideSite> strides;
+
+    Heatmap()
+    {
+        for (auto &c : counts)
+            c.assign(65536, 0);
+    }
+
+    void on_retire(Emu16 &, uint16_t pc, uint16_t inst, uint64_t) override
+    {
+        counts[Fetch][pc]++;
+        if (ISA::words(inst >> 11) == 2)
+            counts[Fetch][uint16_t(pc + 1)]++;
+    }
+
+    void on_load(Emu16 &cpu, uint16_t addr, uint16_t) override
+    {
+        access(cpu, addr, false);
+    }
+
+    void on_store(Emu16 &cpu, uint16_t addr, uint16_t) override
+    {
+        access(cpu, addr, true);
+    }
+
+    uint64_t total(Kind k) const
+    {
+        uint64_t t = 0;
+        for (uint64_t c : counts[k])
+            t += c;
+        return t;
+    }
+
+    void report(std::ostream &o, const Symbols &sym, size_t top = 15) const
+    {
+        o << "=== memory heatmap: " << total(Fetch) << " fetches, " << total(DataRead) << "/" << total(DataWrite)
+          << " data reads/writes, " << total(StackRead) << "/" << total(StackWrite) << " stack reads/writes ===\n";
+        page_map(o, "instruction fetch", {Fetch});
+        page_map(o, "data", {DataRead, DataWrite});
+        page_map(o, "stack", {StackRead, StackWrite});
+
+        o << "--- hottest addresses ---\n"
+          << "  addr     fetch   d-read  d-write   s-read  s-write  symbol\n";
+        for (uint16_t a : hottest(top))
+        {
+            o << "  " << Emu16::hex4(a);
+            for (int k = 0; k < KINDS; ++k)
+                o << " " << std::setw(8) << counts[k][a];
+            o << "  " << sym.format(a) << "\n";
+        }
+
+        o << "--- LD_IND/ST_IND strides ---\n";
+        for (const auto &s : sorted_sites())
+        {
+            const StrideSite &x = s.second;
+            o << "  " << Emu16::hex4(s.first) << "  " << std::setw(10) << x.execs << " execs  stride "
+              << std::setw(5) << x.stride << "  " << std::setw(6) << std::fixed << std::setprecision(1)
+              << regular_pct(x) << "% regular  " << sym.format(s.first) << "\n";
+        }
+    }
+
+    void write_json(std::ostream &o, const Symbols &sym, size_t top = 64) const
+    {
+        static const char *keys[KINDS] = {"fetch", "data_reads", "data_writes", "stack_reads", "stack_writes"};
+        o << "{\n  \"page_words\": " << PAGE_WORDS << ",\n  \"totals\": {";
+        for (int k = 0; k < KINDS; ++k)
+            o << (k ? ", " : "") << "\"" << keys[k] << "\": " << total(Kind(k));
+        o << "},\n  \"pages\": [";
+        bool first = true;
+        for (uint32_t p = 0; p < 65536 / PAGE_WORDS; ++p)
+        {
+            uint64_t sums[KINDS] = {0};
+            uint64_t any = 0;
+            for (int k = 0; k < KINDS; ++k)
+            {
+                for (uint32_t a = p * PAGE_WORDS; a < (p + 1) * PAGE_WORDS; ++a)
+                    sums[k] += counts[k][a];
+                any |= sums[k];
+            }
+            if (!any)
+                continue;
+            o << (first ? "\n" : ",\n") << "    {\"page\": \"" << Emu16::hex4(uint16_t(p * PAGE_WORDS)) << "\"";
+            for (int k = 0; k < KINDS; ++k)
+                o << ", \"" << keys[k] << "\": " << sums[k];
+            o << "}";
+            first = false;
+        }
+        o << "\n  ],\n  \"hottest\": [";
+        first = true;
+        for (uint16_t a : hottest(top))
+        {
+            o << (first ? "\n" : ",\n") << "    {\"addr\": \"" << Emu16::hex4(a) << "\", \"symbol\": \""
+              << json_escape(sym.format(a)) << "\"";
+            for (int k = 0; k < KINDS; ++k)
+                o << ", \"" << keys[k] << "\": " << counts[k][a];
+            o << "}";
+            first = false;
+        }
+        o << "\n  ],\n  \"strides\": [";
+        first = true;
+        for (const auto &s : sorted_sites())
+        {
+            o << (first ? "\n" : ",\n") << "    {\"pc\": \"" << Emu16::hex4(s.first) << "\", \"symbol\": \""
+              << json_escape(sym.format(s.first)) << "\", \"executions\": " << s.second.execs << ", \"stride\": "
+              << s.second.stride << ", \"regular\": " << std::fixed << std::setprecision(4)
+              << regular_pct(s.second) / 100.0 << "}";
+            first = false;
+        }
+        o << "\n  ]\n}\n";
+    }
+
+private:
+    void access(Emu16 &cpu, uint16_t addr, bool write)
+    {
+        const uint16_t op = (cpu.cur_inst >> 11) & 0x1F;
+        const bool stack = op == ISA::PUSH || op == ISA::POP || op == ISA::CALL || op == ISA::RET;
+        counts[stack ? (write ? StackWrite : StackRead) : (write ? DataWrite : DataRead)][addr]++;
+        if (op != ISA::LD_IND && op != ISA::ST_IND)
+            return;
+        StrideSite &s = strides[cpu.cur_pc.load(std::memory_order_relaxed)];
+        if (s.execs)
+        {
+            int32_t step = int16_t(uint16_t(addr - s.last));
+            if (s.execs > 1 && step == s.stride)
+                s.regular++;
+            s.stride = step;
+        }
+        s.last = addr;
+        s.execs++;
+    }
+
+    static double regular_pct(const StrideSite &s)
+    {
+        return s.execs > 2 ? 100.0 * double(s.regular) / double(s.execs - 2) : 0.0;
+    }
+
+    std::vector<std::pair<uint16_t, StrideSite>> sorted_sites() const
+    {
+        std::vector<std::pair<uint16_t, StrideSite>> v(strides.begin(), strides.end());
+        std::sort(v.begin(), v.end(), [](const std::pair<uint16_t, StrideSite> &a, const std::pair<uint16_t, StrideSite> &b)
+                  { return a.second.execs != b.second.execs ? a.second.execs > b.second.execs : a.first < b.first; });
+        return v;
+    }
+
+    std::vector<uint16_t> hottest(size_t top) const
+    {
+        std::vector<std::pair<uint64_t, uint16_t>> v;
+        for (uint32_t a = 0; a < 65536; ++a)
+        {
+            uint64_t t = 0;
+            for (int k = 0; k < KINDS; ++k)
+                t += counts[k][a];
+            if (t)
+                v.push_back({t, uint16_t(a)});
+        }
+        std::sort(v.begin(), v.end(), [](const std::pair<uint64_t, uint16_t> &a, const std::pair<uint64_t, uint16_t> &b)
+                  { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+        std::vector<uint16_t> out;
+        for (size_t i = 0; i < v.size() && i < top; ++i)
+            out.push_back(v[i].second);
+        return out;
+    }
+
+    // One row per 4K words, one cell per page; ' ' = untouched, then
+    // ".:-=+*#%@" by log2 of the page's count relative to the hottest page.
+    void page_map(std::ostream &o, const char *title, std::initializer_list<Kind> kinds) const
+    {
+        static const char shades[] = ".:-=+*#%@";
+        const uint32_t pages = 65536 / PAGE_WORDS;
+        std::vector<uint64_t> sum(pages, 0);
+        uint64_t peak = 0;
+        for (uint32_t p = 0; p < pages; ++p)
+        {
+            for (Kind k : kinds)
+                for (uint32_t a = p * PAGE_WORDS; a < (p + 1) * PAGE_WORDS; ++a)
+                    sum[p] += counts[k][a];
+            peak = std::max(peak, sum[p]);
+        }
+        o << "--- " << title << " by page (peak " << peak << ") ---\n"
+          << "         0123456789ABCDEF\n";
+        for (uint32_t row = 0; row < 16; ++row)
+        {
+            o << "  " << Emu16::hex4(uint16_t(row * 16 * PAGE_WORDS)) << " ";
+            for (uint32_t col = 0; col < 16; ++col)
+            {
+                uint64_t c = sum[row * 16 + col];
+                if (!c)
+                {
+                    o << ' ';
+                    continue;
+                }
+                double level = std::log2(double(c)) / std::log2(double(std::max<uint64_t>(peak, 2)));
+                o << shades[std::min<int>(8, int(level * 8.0))];
+            }
+            o << "\n";
+        }
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * Jobs and results (Job.cpp)
+ * -----------------------------------------------------------------------------
+ * A Job is "run this image with these input patches for at most N cycles";
+ * a JobResult is everything observable afterwards: stop status, registers,
+ * console output and a sparse copy of memory. Shared by the command-line
+ * frontend, the --serve daemon and the result cache.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Emu16.cpp"
+
+// [Job] What to run
+struct Job
+{
+    static constexpr uint64_t DEFAULT_CYCLE_LIMIT = 100000000;
+
+    std::string image;
+    uint64_t cycle_limit = DEFAULT_CYCLE_LIMIT; // 0 = run until HALT
+    std::vector<std::pair<uint16_t, std::vector<uint16_t>>> patches;
+    std::vector<std::pair<uint16_t, uint32_t>> dumps; // (addr, len) ranges to report
+};
+
+// [JobResult] What came out
+struct JobResult
+{
+    std::string status; // halted | budget | fault
+    uint64_t cycles = 0;
+    uint16_t R[8] = {0};
+    uint16_t PC = 0;
+    Flags F{};
+    std::string output;
+    std::vector<std::pair<uint16_t, uint16_t>> memory; // non-zero words, ascending
+};
+
+static inline void apply_patches(Emu16 &emu, const Job &job)
+{
+    for (const auto &p : job.patches)
+    {
+        uint16_t addr = p.first;
+        for (uint16_t w : p.second)
+            emu.mem.poke(addr++, w);
+    }
+}
+
+static inline StopReason run_job_cycles(Emu16 &emu, uint64_t cycle_limit)
+{
+    return emu.run_for(cycle_limit ? cycle_limit : UINT64_MAX);
+}
+
+// Fill `res` from a finished core. With full_memory every non-zero word is
+// kept (what the result cache stores); otherwise only the job's dump ranges.
+static inline void collect_result(const Emu16 &emu, const Job &job, std::string output, JobResult &res, bool full_memory)
+{
+    res.status = emu.faulted ? "fault" : (emu.halted ? "halted" : "budget");
+    res.cycles = emu.cycles;
+    for (int i = 0; i < 8; i++)
+        res.R[i] = emu.R[i];
+    res.PC = emu.PC;
+    res.F = emu.F;
+    res.output = std::move(output);
+    res.memory.clear();
+    const std::vector<uint16_t> &m = emu.mem.mem;
+    if (full_memory)
+    {
+        for (uint32_t a = 0; a < m.size(); ++a)
+            if (m[a])
+                res.memory.push_back({uint16_t(a), m[a]});
+        return;
+    }
+    for (const auto &d : job.dumps)
+    {
+        for (uint32_t a = d.first; a < uint32_t(d.first) + d.second && a < m.size(); ++a)
+            if (m[a])
+                res.memory.push_back({uint16_t(a), m[a]});
+    }
+}
+
+// Expand the sparse memory of a result back into a full 64K-word image.
+static inline void unpack_memory(const JobResult &res, std::vector<uint16_t> &mem)
+{
+    std::fill(mem.begin(), mem.end(), 0);
+    for (const auto &w : res.memory)
+        mem[w.first] = w.second;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// [Loader] Read a flat binary image as written by asm16 (little-endian bytes
+// making 16-bit words). Returns false if the file cannot be opened.
+static inline bool load_image(const std::string &path, std::vector<uint16_t> &rom)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+        return false;
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(f)), {});
+    rom.clear();
+    rom.reserve((bytes.size() + 1) / 2);
+    for (size_t i = 0; i < bytes.size();)
+    {
+        uint16_t w = bytes[i];
+        if (i + 1 < bytes.size())
+            w |= (uint16_t(bytes[i + 1]) << 8);
+        rom.push_back(w);
+        i += 2;
+    }
+    return true;
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+/**
+ * Live metrics in shared memory (Metrics.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --metrics-shm <name>` creates the POSIX shared-memory object /<name>
+ * holding one MetricsPage and refreshes it from the emulating thread between
+ * run slices, at most every `interval` (default 100 ms): instructions
+ * retired, cycles, PC, call depth, console bytes and run state. `emu16-top
+ * <name>` maps the same object read-only and displays it.
+ *
+ * The page is a seqlock: the writer makes `seq` odd, stores the fields, then
+ * makes it even again; a reader copies the fields and retries if `seq` was
+ * odd or changed meanwhile. The writer never waits on a reader, and all
+ * fields are relaxed atomics so the copy is race-free. The object is
+ * unlinked when the publisher goes away; readers that already mapped it keep
+ * the final values.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include "Emu16.cpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// [MetricsPage] Shared layout; bump VERSION when it changes
+struct MetricsPage
+{
+    static constexpr char MAGIC[8] = {'E', '1', '6', 'M', 'E', 'T', 'R', 'C'};
+    static constexpr uint32_t VERSION = 1;
+
+    enum State : uint32_t
+    {
+        Running = 0,
+        Halted = 1,
+        Fault = 2,
+        Budget = 3, // stopped by --max-cycles
+    };
+
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> instructions;
+    std::atomic<uint64_t> cycles;
+    std::atomic<uint64_t> console_bytes;
+    std::atomic<uint64_t> updated_ns; // steady clock of the publisher
+    std::atomic<uint64_t> started_ns;
+    std::atomic<uint32_t> pc;
+    std::atomic<uint32_t> call_depth;
+    std::atomic<uint32_t> state;
+    char image[128]; // program path, NUL-terminated, set once before publishing
+};
+
+// Plain copy of a MetricsPage taken by a reader
+struct MetricsSample
+{
+    uint32_t pid = 0;
+    uint64_t instructions = 0, cycles = 0, console_bytes = 0, updated_ns = 0, started_ns = 0;
+    uint16_t pc = 0;
+    uint32_t call_depth = 0;
+    MetricsPage::State state = MetricsPage::Running;
+    std::string image;
+};
+
+static inline uint64_t metrics_now_ns()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count());
+}
+
+static inline std::string metrics_shm_path(const std::string &name)
+{
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+
+// [MetricsPublisher] Emulator side; owns and unlinks the segment
+class MetricsPublisher
+{
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{100};
+    // Cycles per run slice between clock checks; a slice runs in ~1 ms.
+    static constexpr uint64_t SLICE_CYCLES = 1u << 18;
+
+    ~MetricsPublisher()
+    {
+        close();
+    }
+
+    bool open(const std::string &name, const std::string &image, std::string &err)
+    {
+#ifndef _WIN32
+        path = metrics_shm_path(name);
+        int fd = shm_open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, sizeof(MetricsPage)) != 0)
+        {
+            err = "cannot create shared memory " + path + ": " + std::strerror(errno);
+            if (fd >= 0)
+                ::close(fd);
+            return false;
+        }
+        void *p = mmap(nullptr, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            err = "cannot map " + path;
+            shm_unlink(path.c_str());
+            return false;
+        }
+        page = new (p) MetricsPage();
+        std::memcpy(page->magic, MetricsPage::MAGIC, sizeof(page->magic));
+        page->version = MetricsPage::VERSION;
+        page->pid = uint32_t(getpid());
+        std::strncpy(page->image, image.c_str(), sizeof(page->image) - 1);
+        page->started_ns.store(metrics_now_ns(), std::memory_order_relaxed);
+        return true;
+#else
+        (void)name;
+        (void)image;
+        err = "--metrics-shm needs POSIX shared memory";
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (!page)
+            return;
+        munmap(page, sizeof(MetricsPage));
+        shm_unlink(path.c_str());
+        page = nullptr;
+#endif
+    }
+
+    void publish(const Emu16 &cpu, MetricsPage::State state)
+    {
+        if (!page)
+            return;
+        const auto r = std::memory_order_relaxed;
+        uint64_t s = page->seq.load(r);
+        page->seq.store(s + 1, r);
+        std::atomic_thread_fence(std::memory_order_release);
+        page->instructions.store(cpu.retired, r);
+        page->cycles.store(cpu.cycles, r);
+        page->console_bytes.store(cpu.mem.io.console_bytes.load(r), r);
+        page->pc.store(cpu.PC, r);
+        page->call_depth.store(cpu.shadow_depth.load(r), r);
+        page->state.store(state, r);
+        page->updated_ns.store(metrics_now_ns(), r);
+        page->seq.store(s + 2, std::memory_order_release);
+    }
+
+    // run_job_cycles() in slices, publishing at most once per `interval`
+    // and once more with the final state.
+    StopReason run(Emu16 &emu, uint64_t cycle_limit, std::chrono::milliseconds interval = DEFAULT_INTERVAL)
+    {
+        const uint64_t end = cycle_limit ? emu.cycles + cycle_limit : UINT64_MAX;
+        emu.shadow_calls = true;
+        publish(emu, MetricsPage::Running);
+        auto next = std::chrono::steady_clock::now() + interval;
+        StopReason r = StopReason::Budget;
+        while (emu.cycles < end)
+        {
+            r = emu.run_for(std::min<uint64_t>(SLICE_CYCLES, end - emu.cycles));
+            if (r != StopReason::Budget)
+                break;
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next)
+            {
+                publish(emu, MetricsPage::Running);
+                next = now + interval;
+            }
+        }
+        emu.shadow_calls = false;
+        publish(emu, emu.faulted ? MetricsPage::Fault : (emu.halted ? MetricsPage::Halted : MetricsPage::Budget));
+        return r;
+    }
+
+private:
+    std::string path;
+    MetricsPage *page = nullptr;
+};
+
+// [MetricsReader] emu16-top side; maps the segment read-only
+class MetricsReader
+{
+public:
+    ~MetricsReader()
+    {
+#ifndef _WIN32
+        if (page)
+            munmap(const_cast<MetricsPage *>(page), sizeof(MetricsPage));
+#endif
+    }
+
+    bool open(const std::string &name, std::string &err)
+    {
+#ifndef _WIN32
+        std::string path = metrics_shm_path(name);
+        int fd = shm_open(path.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+            err = "no metrics segment " + path + " (is emu16 running with --metrics-shm?)";
+            return false;
+        }
+        void *p = mmap(nullptr, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            err = "cannot map " + path;
+            return false;
+        }
+        page = static_cast<const MetricsPage *>(p);
+        if (std::memcmp(page->magic, MetricsPage::MAGIC, sizeof(page->magic)) != 0 ||
+            page->version != MetricsPage::VERSION)
+        {
+            err = path + " is not an emu16 metrics segment of version " + std::to_string(MetricsPage::VERSION);
+            return false;
+        }
+        return true;
+#else
+        (void)name;
+        err = "emu16-top needs POSIX shared memory";
+        return false;
+#endif
+    }
+
+    // Consistent copy of the page; false if the writer kept it busy.
+    bool read(MetricsSample &out) const
+    {
+        const auto r = std::memory_order_relaxed;
+        for (int attempt = 0; attempt < 1000; ++attempt)
+        {
+            uint64_t s0 = page->seq.load(std::memory_order_acquire);
+            if (s0 & 1)
+                continue;
+            out.pid = page->pid;
+            out.instructions = page->instructions.load(r);
+            out.cycles = page->cycles.load(r);
+            out.console_bytes = page->console_bytes.load(r);
+            out.updated_ns = page->updated_ns.load(r);
+            out.started_ns = page->started_ns.load(r);
+            out.pc = uint16_t(page->pc.load(r));
+            out.call_depth = page->call_depth.load(r);
+            out.state = MetricsPage::State(page->state.load(r));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (page->seq.load(r) == s0)
+            {
+                out.image.assign(page->image, strnlen(page->image, sizeof(page->image)));
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const MetricsPage *page = nullptr;
+};
@@ -0,0 +1,521 @@
+#pragma once
+
+/**
+ * Microcoded sequencer (Microcode.cpp)
+ * -----------------------------------------------------------------------------
+ * A second execution engine that runs guest code through the datapath of
+ * docs/hw.dot, one microstate per clock, from a microcode ROM. Every ROM word
+ * is a set of control signals for one cycle:
+ *
+ *   mem_rd mem_wr rf_we pc_we sp_we ir_ld ext_ld     (hw.dot, 1 bit each)
+ *   alu_op sel_alu_b sel_pc sel_mem_addr sel_mem_wd sel_sp_src   (hw.dot)
+ *   sel_alu_a sel_rf_wd mdr_ld flags cond halt end    (added, see below)
+ *
+ * The sequencer starts every instruction at FETCH (ROM word 0); the decoder
+ * then jumps to the opcode's routine through the dispatch table and steps
+ * through it until a word with `end`. Two-word instructions begin their
+ * routine with an EXT cycle that latches the second word.
+ *
+ * hw.dot draws the wires but leaves a few selections implicit; they are
+ * explicit signals here: which value the ALU's A input takes (rd, the CAS
+ * address register ra, or MDR), whether the register file writes the ALU
+ * result, the data bus or MDR, a memory data register and last-address
+ * register for the read-modify-write atomics, the flag update mode, and a
+ * condition that turns a PC load into PC+1 and suppresses a memory write
+ * when false (Jcc, CAS).
+ *
+ * Within one cycle all register reads see the values from the start of the
+ * cycle and all writes land at its end, as in hardware. Where the fast
+ * engine's sequential semantics would need a register both read and written
+ * (PUSH r7, POP r7) the routine spends a second cycle.
+ *
+ * Timing: `ucycles` counts datapath clocks. Emu16::cycles keeps advancing by
+ * the fast engine's ISA cost model (one per fetched word plus each opcode's
+ * fixed extra), so TIMER reads, cycle budgets and cosim16 hashes match the
+ * interpreter exactly while ucycles gives the datapath count.
+ */
+
+#include <cstdint>
+#include <ostream>
+#include <iomanip>
+#include "Emu16.cpp"
+
+namespace Micro
+{
+    // 1-bit control signals
+    enum Signal : uint16_t
+    {
+        MEM_RD = 1 << 0,
+        MEM_WR = 1 << 1,
+        RF_WE = 1 << 2,
+        PC_WE = 1 << 3,
+        SP_WE = 1 << 4,
+        IR_LD = 1 << 5,
+        EXT_LD = 1 << 6,
+        MDR_LD = 1 << 7,
+        HALT = 1 << 8,
+        END = 1 << 9,
+    };
+    enum AluOp : uint8_t
+    {
+        ALU_NONE,
+        ALU_ADD,
+        ALU_SUB,
+        ALU_AND,
+        ALU_OR,
+        ALU_XOR,
+        ALU_NOT,
+        ALU_SHL,
+        ALU_SHR,
+        ALU_MUL,
+        ALU_PASS_A,
+        ALU_PASS_B,
+    };
+    enum SelA : uint8_t { A_RD, A_RA, A_MDR };
+    enum SelB : uint8_t { B_RS, B_EXT, B_MDR };
+    enum SelPc : uint8_t { PC_INC, PC_EXT, PC_BUS };
+    enum SelAddr : uint8_t { MA_PC, MA_ALU, MA_SP, MA_SP_DEC, MA_MAR };
+    enum SelWd : uint8_t { WD_RS, WD_PC, WD_ALU };
+    enum SelSp : uint8_t { SP_DEC, SP_INC };
+    enum SelRf : uint8_t { RF_ALU, RF_BUS, RF_MDR };
+    enum FlagMode : uint8_t
+    {
+        FL_NONE,
+        FL_ALU,   // N Z C V from the ALU
+        FL_ZN,    // Z N from the value written to the register file
+        FL_ZN_EQ, // as FL_ZN, then Z = (MDR == rd) (CAS success)
+    };
+    enum Cond : uint8_t { C_ALWAYS, C_Z, C_NZ, C_C, C_N, C_EQ };
+
+    // One ROM word. Built with the chained setters below so the table reads
+    // as signal lists.
+    struct Word
+    {
+        const char *name = "";
+        uint16_t sig = 0;
+        uint8_t alu = ALU_NONE;
+        uint8_t a = A_RD, b = B_RS;
+        uint8_t pc = PC_INC, addr = MA_PC, wd = WD_RS, sp = SP_DEC, rf = RF_ALU;
+        uint8_t flags = FL_NONE, cond = C_ALWAYS;
+
+        constexpr explicit Word(const char *n) : name(n) {}
+        constexpr Word op(AluOp o, SelA sa = A_RD, SelB sb = B_RS) const
+        {
+            Word w = *this;
+            w.alu = o;
+            w.a = sa;
+            w.b = sb;
+            return w;
+        }
+        constexpr Word read(SelAddr m) const
+        {
+            Word w = *this;
+            w.sig |= MEM_RD;
+            w.addr = m;
+            return w;
+        }
+        constexpr Word write(SelAddr m, SelWd d) const
+        {
+            Word w = *this;
+            w.sig |= MEM_WR;
+            w.addr = m;
+            w.wd = d;
+            return w;
+        }
+        constexpr Word reg(SelRf r, FlagMode f) const
+        {
+            Word w = *this;
+            w.sig |= RF_WE;
+            w.rf = r;
+            w.flags = f;
+            return w;
+        }
+        constexpr Word flag(FlagMode f) const
+        {
+            Word w = *this;
+            w.flags = f;
+            return w;
+        }
+        constexpr Word next_pc(SelPc p, Cond c = C_ALWAYS) const
+        {
+            Word w = *this;
+            w.sig |= PC_WE;
+            w.pc = p;
+            w.cond = c;
+            return w;
+        }
+        constexpr Word stack(SelSp s) const
+        {
+            Word w = *this;
+            w.sig |= SP_WE;
+            w.sp = s;
+            return w;
+        }
+        constexpr Word when(Cond c) const
+        {
+            Word w = *this;
+            w.cond = c;
+            return w;
+        }
+        constexpr Word with(uint16_t s) const
+        {
+            Word w = *this;
+            w.sig |= s;
+            return w;
+        }
+        constexpr Word end() const { return with(END); }
+    };
+
+    // Fetch and the EXT cycle that starts every two-word routine
+    constexpr Word FETCH_W = Word("FETCH").read(MA_PC).with(IR_LD).next_pc(PC_INC);
+    constexpr Word EXT_W = Word("EXT").read(MA_PC).with(EXT_LD).next_pc(PC_INC);
+
+    static const Word ROM[] = {
+        FETCH_W,                                                                      // 0
+        Word("MOV").op(ALU_PASS_B).reg(RF_ALU, FL_ZN).end(),                          // 1
+        Word("ADD").op(ALU_ADD).reg(RF_ALU, FL_ALU).end(),                            // 2
+        Word("SUB").op(ALU_SUB).reg(RF_ALU, FL_ALU).end(),                            // 3
+        Word("AND").op(ALU_AND).reg(RF_ALU, FL_ALU).end(),                            // 4
+        Word("OR").op(ALU_OR).reg(RF_ALU, FL_ALU).end(),                              // 5
+        Word("XOR").op(ALU_XOR).reg(RF_ALU, FL_ALU).end(),                            // 6
+        Word("NOT").op(ALU_NOT).reg(RF_ALU, FL_ALU).end(),                            // 7
+        Word("SHL").op(ALU_SHL).reg(RF_ALU, FL_ALU).end(),                            // 8
+        Word("SHR").op(ALU_SHR).reg(RF_ALU, FL_ALU).end(),                            // 9
+        Word("CMP").op(ALU_SUB).flag(FL_ALU).end(),                                   // 10
+        Word("PUSH.1").stack(SP_DEC),                                                 // 11
+        Word("PUSH.2").write(MA_SP, WD_RS).end(),                                     // 12
+        Word("POP.1").read(MA_SP).reg(RF_BUS, FL_ZN),                                 // 13
+        Word("POP.2").stack(SP_INC).end(),                                            // 14
+        EXT_W,                                                                        // 15 LD_ABS
+        Word("LD_ABS").op(ALU_PASS_B, A_RD, B_EXT).read(MA_ALU).reg(RF_BUS, FL_ZN).end(), // 16
+        EXT_W,                                                                        // 17 ST_ABS
+        Word("ST_ABS").op(ALU_PASS_B, A_RD, B_EXT).write(MA_ALU, WD_RS).end(),        // 18
+        Word("LDI").read(MA_PC).with(EXT_LD).next_pc(PC_INC).reg(RF_BUS, FL_ZN).end(), // 19 LDI, LEA
+        Word("JMP").read(MA_PC).with(EXT_LD).next_pc(PC_BUS).end(),                   // 20
+        Word("JZ").read(MA_PC).with(EXT_LD).next_pc(PC_BUS, C_Z).end(),               // 21
+        Word("JNZ").read(MA_PC).with(EXT_LD).next_pc(PC_BUS, C_NZ).end(),             // 22
+        Word("JC").read(MA_PC).with(EXT_LD).next_pc(PC_BUS, C_C).end(),               // 23
+        Word("JN").read(MA_PC).with(EXT_LD).next_pc(PC_BUS, C_N).end(),               // 24
+        EXT_W,                                                                        // 25 CALL
+        Word("CALL").write(MA_SP_DEC, WD_PC).stack(SP_DEC).next_pc(PC_EXT).end(),     // 26
+        Word("RET").read(MA_SP).next_pc(PC_BUS).stack(SP_INC).end(),                  // 27
+        Word("HALT").with(HALT).end(),                                                // 28
+        Word("LD_IND").op(ALU_PASS_B).read(MA_ALU).reg(RF_BUS, FL_ZN).end(),          // 29
+        Word("ST_IND").op(ALU_PASS_A).write(MA_ALU, WD_RS).end(),                     // 30
+        EXT_W,                                                                        // 31 ADDI
+        Word("ADDI").op(ALU_ADD, A_RD, B_EXT).reg(RF_ALU, FL_ALU).end(),              // 32
+        EXT_W,                                                                        // 33 SUBI
+        Word("SUBI").op(ALU_SUB, A_RD, B_EXT).reg(RF_ALU, FL_ALU).end(),              // 34
+        Word("MUL").op(ALU_MUL).reg(RF_ALU, FL_ALU).end(),                            // 35
+        Word("CAS.1").op(ALU_PASS_A, A_RA).read(MA_ALU).with(MDR_LD),                 // 36
+        Word("CAS.2").write(MA_MAR, WD_RS).when(C_EQ).reg(RF_MDR, FL_ZN_EQ).end(),    // 37
+        Word("FADD.1").op(ALU_PASS_B).read(MA_ALU).with(MDR_LD),                      // 38
+        Word("FADD.2").op(ALU_ADD, A_RD, B_MDR).write(MA_MAR, WD_ALU).reg(RF_MDR, FL_ZN).end(), // 39
+    };
+    static constexpr uint8_t NONE = 0xFF; // routine is FETCH alone
+
+    // Decoder: opcode -> first ROM word of its routine, and the cycles the
+    // fast engine charges on top of one per fetched word.
+    struct Dispatch
+    {
+        uint8_t start;
+        uint8_t isa_extra;
+    };
+    static const Dispatch DISPATCH[32] = {
+        {NONE, 0}, {1, 1}, {2, 1}, {3, 1}, {4, 1}, {5, 1}, {6, 1}, {7, 1},      // NOP..NOT
+        {8, 1}, {9, 1}, {10, 0}, {11, 1}, {13, 2}, {15, 1}, {17, 1}, {19, 1},   // SHL..LDI
+        {20, 0}, {21, 0}, {22, 0}, {23, 0}, {24, 0}, {25, 1}, {27, 1}, {28, 0}, // JMP..HALT
+        {29, 1}, {30, 1}, {19, 1}, {31, 1}, {33, 1}, {35, 1}, {36, 2}, {38, 2}, // LD_IND..FADD
+    };
+}
+
+// Runs an Emu16's architectural state through the microcode. Not a probe
+// host: attached probes are ignored. Counters accumulate across calls.
+struct MicroEngine
+{
+    uint64_t ucycles = 0;      // datapath clocks
+    uint64_t instructions = 0; // retired through this engine
+
+    // Same contract as Emu16::run_for(): stop at the first instruction
+    // boundary at or past the budget (in Emu16::cycles), on HALT, or when a
+    // device store requests a stop.
+    StopReason run_for(Emu16 &e, uint64_t max_cycles)
+    {
+        if (e.halted)
+            return e.faulted ? StopReason::Fault : StopReason::Halted;
+        uint64_t end = (max_cycles > UINT64_MAX - e.cycles) ? UINT64_MAX : e.cycles + max_cycles;
+        e.stop_requested = false;
+        while (e.cycles < end)
+        {
+            instruction(e);
+            if (e.stop_requested)
+            {
+                e.stop_requested = false;
+                return e.pending;
+            }
+        }
+        return StopReason::Budget;
+    }
+
+    // Exactly n instructions (fewer if the guest halts); returns the
+    // datapath clocks they took.
+    uint64_t run_instructions(Emu16 &e, uint64_t n)
+    {
+        uint64_t u0 = ucycles;
+        for (uint64_t i = 0; i < n && !e.halted; ++i)
+            instruction(e);
+        e.stop_requested = false;
+        return ucycles - u0;
+    }
+
+    void instruction(Emu16 &e)
+    {
+        using namespace Micro;
+        e.cur_pc.store(e.PC, std::memory_order_relaxed);
+        e.retired++;
+        instructions++;
+        Latches l;
+        l.pc0 = e.PC;
+        clock(e, ROM[0], l);
+        const Dispatch &d = DISPATCH[(l.ir >> 11) & 0x1F];
+        if (d.start != NONE)
+        {
+            for (uint32_t upc = d.start;; ++upc)
+            {
+                clock(e, ROM[upc], l);
+                if (ROM[upc].sig & END)
+                    break;
+            }
+        }
+        e.cycles += d.isa_extra;
+        flow(e, l);
+    }
+
+    // The ROM as a table: one line per word with its active signals
+    static void dump(std::ostream &o)
+    {
+        using namespace Micro;
+        static const char *alu[] = {"", "ADD", "SUB", "AND", "OR", "XOR", "NOT", "SHL", "SHR", "MUL", "PASS_A", "PASS_B"};
+        static const char *sa[] = {"rd", "ra", "MDR"}, *sb[] = {"rs", "EXT", "MDR"};
+        static const char *spc[] = {"PC+1", "EXT", "MemData"}, *sma[] = {"PC", "ALU", "SP", "SP-1", "MAR"};
+        static const char *swd[] = {"rs", "PC_next", "ALU"}, *ssp[] = {"SP-1", "SP+1"}, *srf[] = {"ALU", "MemData", "MDR"};
+        static const char *sfl[] = {"", "NZCV", "ZN", "ZN,Z=EQ"}, *scond[] = {"", "Z", "!Z", "C", "N", "EQ"};
+        for (size_t i = 0; i < sizeof(ROM) / sizeof(ROM[0]); ++i)
+        {
+            const Word &w = ROM[i];
+            o << std::setw(3) << i << "  " << std::left << std::setw(8) << w.name << std::right;
+            if (w.alu != ALU_NONE)
+                o << " alu_op=" << alu[w.alu] << "(" << sa[w.a] << "," << sb[w.b] << ")";
+            if (w.sig & MEM_RD)
+                o << " mem_rd[" << sma[w.addr] << "]";
+            if (w.sig & MEM_WR)
+                o << " mem_wr[" << sma[w.addr] << "]=" << swd[w.wd];
+            if (w.sig & IR_LD)
+                o << " ir_ld";
+            if (w.sig & EXT_LD)
+                o << " ext_ld";
+            if (w.sig & MDR_LD)
+                o << " mdr_ld";
+            if (w.sig & RF_WE)
+                o << " rf_we=" << srf[w.rf];
+            if (w.flags != FL_NONE)
+                o << " flags=" << sfl[w.flags];
+            if (w.sig & PC_WE)
+                o << " pc_we=" << spc[w.pc];
+            if (w.sig & SP_WE)
+                o << " sp_we=" << ssp[w.sp];
+            if (w.cond != C_ALWAYS)
+                o << " if " << scond[w.cond];
+            if (w.sig & HALT)
+                o << " halt";
+            if (w.sig & END)
+                o << " end";
+            o << "\n";
+        }
+    }
+
+private:
+    struct Latches
+    {
+        uint16_t ir = 0, ext = 0, mdr = 0, mar = 0;
+        uint16_t pc0 = 0;
+        bool taken = false;
+    };
+
+    // One datapath clock: combinational reads from start-of-cycle state,
+    // then register, SP and PC writes.
+    void clock(Emu16 &e, const Micro::Word &w, Latches &l)
+    {
+        using namespace Micro;
+        ucycles++;
+        const uint16_t rd = (l.ir >> 8) & 7, rs = (l.ir >> 5) & 7, ra = (l.ir >> 2) & 7;
+        const uint16_t sp = e.R[7], vrd = e.R[rd], vrs = e.R[rs];
+
+        bool cond = true;
+        switch (w.cond)
+        {
+        case C_Z:
+            cond = e.F.Z;
+            break;
+        case C_NZ:
+            cond = !e.F.Z;
+            break;
+        case C_C:
+            cond = e.F.C;
+            break;
+        case C_N:
+            cond = e.F.N;
+            break;
+        case C_EQ:
+            cond = (l.mdr == vrd);
+            break;
+        default:
+            break;
+        }
+
+        uint16_t alu = 0;
+        Flags f = e.F;
+        if (w.alu != ALU_NONE)
+        {
+            uint16_t a = (w.a == A_RD) ? vrd : (w.a == A_RA) ? e.R[ra] : l.mdr;
+            uint16_t b = (w.b == B_RS) ? vrs : (w.b == B_EXT) ? l.ext : l.mdr;
+            switch (w.alu)
+            {
+            case ALU_ADD:
+                alu = ALU::add(a, b, f);
+                break;
+            case ALU_SUB:
+                alu = ALU::sub(a, b, f);
+                break;
+            case ALU_AND:
+                alu = ALU::band(a, b, f);
+                break;
+            case ALU_OR:
+                alu = ALU::bor(a, b, f);
+                break;
+            case ALU_XOR:
+                alu = ALU::bxor(a, b, f);
+                break;
+            case ALU_NOT:
+                alu = ALU::bnot(a, f);
+                break;
+            case ALU_SHL:
+                alu = ALU::shl(a, b, f);
+                break;
+            case ALU_SHR:
+                alu = ALU::shr(a, b, f);
+                break;
+            case ALU_MUL:
+                alu = ALU::mul(a, b, f);
+                break;
+            case ALU_PASS_A:
+                alu = a;
+                break;
+            default:
+                alu = b;
+                break;
+            }
+        }
+
+        uint16_t addr = 0, bus = 0;
+        if (w.sig & (MEM_RD | MEM_WR))
+        {
+            switch (w.addr)
+            {
+            case MA_PC:
+                addr = e.PC;
+                break;
+            case MA_ALU:
+                addr = alu;
+                break;
+            case MA_SP:
+                addr = sp;
+                break;
+            case MA_SP_DEC:
+                addr = uint16_t(sp - 1);
+                break;
+            default:
+                addr = l.mar;
+                break;
+            }
+            l.mar = addr;
+        }
+        if (w.sig & MEM_RD)
+        {
+            bus = e.mem.read(addr, e.cycles, e.core_id);
+            if (w.sig & IR_LD)
+                l.ir = bus;
+            if (w.sig & EXT_LD)
+                l.ext = bus;
+            if (w.sig & MDR_LD)
+                l.mdr = bus;
+            if (w.addr == MA_PC)
+                e.cycles++; // instruction word fetched (ISA cost model)
+        }
+        if ((w.sig & MEM_WR) && cond)
+        {
+            uint16_t d = (w.wd == WD_RS) ? vrs : (w.wd == WD_PC) ? e.PC : alu;
+            if (w.addr == MA_MAR)
+                e.mem.write(addr, d); // atomic write-back: memory port only, as Memory::cas/fetch_add
+            else
+                e.store<false>(addr, d);
+        }
+
+        if (w.sig & RF_WE)
+        {
+            uint16_t v = (w.rf == RF_ALU) ? alu : (w.rf == RF_BUS) ? bus : l.mdr;
+            e.R[rd] = v;
+            if (w.flags == FL_ALU)
+                e.F = f;
+            e.F.Z = (v == 0);
+            e.F.N = (v & 0x8000) != 0;
+            if (w.flags == FL_ZN_EQ)
+                e.F.Z = cond;
+        }
+        else if (w.flags == FL_ALU)
+            e.F = f;
+
+        if (w.sig & SP_WE)
+        {
+            e.R[7] = (w.sp == SP_DEC) ? uint16_t(e.R[7] - 1) : uint16_t(e.R[7] + 1);
+            e.sp_low = std::min(e.sp_low, e.R[7]);
+        }
+        if (w.sig & PC_WE)
+        {
+            SelPc p = (cond || w.pc == PC_INC) ? SelPc(w.pc) : PC_INC;
+            e.PC = (p == PC_INC) ? uint16_t(e.PC + 1) : (p == PC_EXT) ? l.ext : bus;
+            l.taken = cond;
+        }
+        if (w.sig & HALT)
+        {
+            e.halted = true;
+            e.stop_now(StopReason::Halted);
+        }
+    }
+
+    // Flight recorder, as the fast engine keeps it for JMP/Jcc/CALL/RET.
+    static void flow(Emu16 &e, const Latches &l)
+    {
+        uint16_t op = (l.ir >> 11) & 0x1F;
+        switch (op)
+        {
+        case ISA::JMP:
+            e.flow<false>(Flow::Jump, l.pc0, l.ext, true);
+            break;
+        case ISA::JZ:
+        case ISA::JNZ:
+        case ISA::JC:
+        case ISA::JN:
+            e.flow<false>(Flow::Branch, l.pc0, l.ext, l.taken);
+            break;
+        case ISA::CALL:
+            e.flow<false>(Flow::Call, l.pc0, l.ext, true);
+            break;
+        case ISA::RET:
+            e.flow<false>(Flow::Ret, l.pc0, e.PC, true);
+            break;
+        default:
+            break;
+        }
+    }
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+/**
+ * Multi-core wrapper (MultiCore.cpp)
+ * -----------------------------------------------------------------------------
+ * N Emu16 cores, each with its own registers/PC/SP/cycle counter, attached to
+ * one shared Memory. Guests tell cores apart by reading CORE_ID (0xFF30) and
+ * coordinate through the atomic CAS/FADD instructions.
+ *
+ * Two schedulers:
+ *   • run_quantum(q): deterministic. One host thread visits the cores in
+ *     order, each running until its cycle counter reaches the next multiple
+ *     of q, so cores advance in lockstep windows and every run is identical.
+ *   • run_threaded(): one host thread per core, free-running. Faster, but
+ *     interleavings (and therefore output ordering) depend on the host.
+ *
+ * The machine is done when every core has halted. Under run_threaded() RAM is
+ * accessed atomically (Memory::set_shared): plain LD/ST are relaxed, so they
+ * never tear but are not ordered across cores, while CAS/FADD are
+ * acquire/release RMWs; guests should hand off data through CAS/FADD.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Emu16.cpp"
+
+struct MultiCore
+{
+    static constexpr unsigned MAX_CORES = 16;
+
+    Memory mem;
+    std::vector<std::unique_ptr<Emu16>> cores;
+
+    MultiCore(unsigned n, bool trace)
+    {
+        mem.io.core_count = uint16_t(n);
+        for (unsigned i = 0; i < n; ++i)
+            cores.emplace_back(new Emu16(trace, mem, uint16_t(i)));
+    }
+
+    void load(const std::vector<uint16_t> &image, uint16_t base)
+    {
+        cores.front()->load(image, base);
+    }
+    void reset()
+    {
+        for (auto &c : cores)
+            c->reset();
+    }
+    bool all_halted() const
+    {
+        for (const auto &c : cores)
+            if (!c->halted)
+                return false;
+        return true;
+    }
+    uint64_t max_cycles() const
+    {
+        uint64_t m = 0;
+        for (const auto &c : cores)
+            m = c->cycles > m ? c->cycles : m;
+        return m;
+    }
+
+    void run_quantum(uint64_t quantum)
+    {
+        mem.set_shared(false);
+        uint64_t window = 0;
+        while (!all_halted())
+        {
+            window += quantum;
+            for (auto &c : cores)
+            {
+                if (c->cycles < window)
+                    c->run_for(window - c->cycles);
+            }
+        }
+    }
+
+    void run_threaded()
+    {
+        mem.set_shared(true);
+        std::vector<std::thread> threads;
+        for (auto &c : cores)
+        {
+            Emu16 *core = c.get();
+            threads.emplace_back([core]
+                                 { core->run(); });
+        }
+        for (auto &t : threads)
+            t.join();
+        mem.set_shared(false);
+    }
+};
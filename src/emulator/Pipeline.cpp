@@ -0,0 +1,363 @@
+#pragma once
+
+/**
+ * Five-stage pipeline timing model (Pipeline.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --pipeline out.json` attaches this probe and times the retired
+ * instruction stream on a classic in-order IF ID EX MEM WB pipeline:
+ *
+ *   IF   one word per cycle, so a two-word instruction holds IF for two
+ *        cycles before it can decode (the "fetch" stall),
+ *   ID   reads registers and flags; a jump/call target is known at its end,
+ *   EX   ALU, address generation, SP +/- 1, conditional branches resolve,
+ *   MEM  loads, stores, the RET target and the CAS/FADD read-modify-write,
+ *   WB   register file.
+ *
+ * Full forwarding: an EX result feeds the next instruction's EX, a loaded
+ * value feeds EX one cycle after MEM (the load-use stall). Store data and
+ * the CAS/FADD operands are consumed in MEM. JMP/CALL cost one bubble (the
+ * target is their second word, known after ID). Without a predictor fetch
+ * assumes not-taken, so a taken Jcc flushes IF/ID and RET waits for MEM.
+ * With one (predict_with(), BranchPredictor.cpp) a correctly predicted taken
+ * Jcc, and a RET the return-address stack got right, cost one bubble like
+ * JMP, and a mispredicted Jcc flushes.
+ *
+ * Every cycle an instruction enters EX later than one after its predecessor
+ * is charged to one cause (fetch, load-use, stack, flags, branch, jump,
+ * return) and to its PC, so cycles = instructions + stalls + pipeline fill.
+ * Timing is independent of the core's own cycle count; a checkpoint or a
+ * run can start the model at any instruction.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "BranchPredictor.cpp"
+#include "Emu16.cpp"
+#include "Report.cpp"
+#include "Symbols.cpp"
+
+struct Pipeline : Probe
+{
+    enum Cause
+    {
+        Fetch,   // second word of a two-word instruction
+        LoadUse, // waits for a value loaded by LD/POP/CAS/FADD
+        Stack,   // waits for SP from PUSH/POP/CALL/RET
+        Flags,   // Jcc waits for flags set by a load
+        Branch,  // Jcc redirect: taken, or mispredicted
+        Jump,    // JMP/CALL redirect after decode
+        Return,  // RET target comes from MEM
+        CAUSES,
+    };
+    static const char *cause_name(int c)
+    {
+        static const char *names[CAUSES] = {"fetch", "load-use", "stack", "flags", "branch", "jump", "return"};
+        return names[c];
+    }
+
+    static constexpr int FLAGS_REG = 8; // scoreboard slot for the flags
+
+    uint64_t instructions = 0;
+    uint64_t stalls[CAUSES] = {0};
+    uint64_t branches = 0, taken = 0, mispredicts = 0;
+    uint64_t returns = 0, ras_misses = 0;
+    std::unique_ptr<BranchPredictor> predictor; // null: static not-taken
+    std::unique_ptr<ReturnStack> ras;
+    std::vector<uint64_t> pc_execs, pc_stalls;
+    std::vector<uint8_t> pc_cause; // cause of the latest stall per PC
+
+    Pipeline() : pc_execs(65536, 0), pc_stalls(65536, 0), pc_cause(65536, 0) {}
+
+    void predict_with(std::unique_ptr<BranchPredictor> p, unsigned ras_depth)
+    {
+        predictor = std::move(p);
+        ras.reset(new ReturnStack(ras_depth));
+    }
+
+    // Cycles from the first fetch to the end of the last write-back.
+    uint64_t cycles() const
+    {
+        return instructions ? last_ex + 3 : 0;
+    }
+
+    double cpi() const
+    {
+        return instructions ? double(cycles()) / double(instructions) : 0.0;
+    }
+
+    void on_flow(Emu16 &, Flow kind, uint16_t pc, uint16_t target, bool t) override
+    {
+        if (kind == Flow::Branch)
+        {
+            branches++;
+            taken += t;
+            branch_taken = t;
+            branch_predicted = predictor ? predictor->predict(pc, target) : false;
+            mispredicts += branch_predicted != t;
+            if (predictor)
+                predictor->update(pc, t);
+        }
+        else if (kind == Flow::Call && ras)
+            ras->push(uint16_t(pc + 2));
+        else if (kind == Flow::Ret && ras)
+        {
+            uint16_t ra = 0;
+            returns++;
+            ret_predicted = ras->pop(ra) && ra == target;
+            ras_misses += !ret_predicted;
+        }
+    }
+
+    void on_retire(Emu16 &, uint16_t pc, uint16_t inst, uint64_t) override
+    {
+        const uint16_t op = (inst >> 11) & 0x1F;
+        const int rd = (inst >> 8) & 7, rs = (inst >> 5) & 7, ra = (inst >> 2) & 7;
+        const uint64_t words = ISA::words(op);
+
+        // Front end: IF starts when the previous instruction moved to ID, or
+        // at its redirect; ID waits for the last word and for EX to take the
+        // previous instruction.
+        const uint64_t f_plain = last_id;
+        const uint64_t f = std::max(f_plain, redirect);
+        const uint64_t id = std::max(f + words, last_ex);
+
+        // EX one cycle after the predecessor's unless something holds it;
+        // each extra cycle is charged to the constraint that set it.
+        uint64_t ex = instructions ? last_ex + 1 : f + words + 1;
+        uint64_t gap = 0, worst = 0;
+        int cause = CAUSES;
+        auto charge = [&](uint64_t t, int c)
+        {
+            if (t <= ex)
+                return;
+            if (instructions)
+            {
+                stalls[c] += t - ex;
+                gap += t - ex;
+                if (t - ex > worst)
+                {
+                    worst = t - ex;
+                    cause = c;
+                }
+            }
+            ex = t;
+        };
+        charge(f_plain + words + 1, Fetch);
+        charge(f + words + 1, redirect_cause);
+
+        // Operands: EX-stage sources, and MEM-stage sources one cycle later
+        auto need = [&](int r, uint64_t lead)
+        {
+            uint64_t t = ready[r] > lead ? ready[r] - lead : 0;
+            charge(t, r == 7 ? Stack : r == FLAGS_REG ? Flags : LoadUse);
+        };
+        switch (op)
+        {
+        case ISA::MOV:
+            need(rs, 0);
+            break;
+        case ISA::ADD:
+        case ISA::SUB:
+        case ISA::AND:
+        case ISA::OR:
+        case ISA::XOR:
+        case ISA::SHL:
+        case ISA::SHR:
+        case ISA::MUL:
+        case ISA::CMP:
+            need(rd, 0);
+            need(rs, 0);
+            break;
+        case ISA::NOT_:
+        case ISA::ADDI:
+        case ISA::SUBI:
+            need(rd, 0);
+            break;
+        case ISA::PUSH:
+            need(7, 0);
+            need(rs, 1);
+            break;
+        case ISA::POP:
+        case ISA::CALL:
+        case ISA::RET:
+            need(7, 0);
+            break;
+        case ISA::ST_ABS:
+            need(rs, 1);
+            break;
+        case ISA::JZ:
+        case ISA::JNZ:
+        case ISA::JC:
+        case ISA::JN:
+            need(FLAGS_REG, 0);
+            break;
+        case ISA::LD_IND:
+        case ISA::FADD:
+            need(rs, 0);
+            if (op == ISA::FADD)
+                need(rd, 1);
+            break;
+        case ISA::ST_IND:
+            need(rd, 0);
+            need(rs, 1);
+            break;
+        case ISA::CAS:
+            need(ra, 0);
+            need(rd, 1);
+            need(rs, 1);
+            break;
+        default:
+            break;
+        }
+
+        // Results: EX results forward next cycle, loads one cycle after MEM
+        const uint64_t alu = ex + 1, load = ex + 2;
+        switch (op)
+        {
+        case ISA::MOV:
+        case ISA::ADD:
+        case ISA::SUB:
+        case ISA::AND:
+        case ISA::OR:
+        case ISA::XOR:
+        case ISA::NOT_:
+        case ISA::SHL:
+        case ISA::SHR:
+        case ISA::MUL:
+        case ISA::LDI:
+        case ISA::LEA:
+        case ISA::ADDI:
+        case ISA::SUBI:
+            ready[rd] = alu;
+            ready[FLAGS_REG] = alu;
+            break;
+        case ISA::CMP:
+            ready[FLAGS_REG] = alu;
+            break;
+        case ISA::PUSH:
+        case ISA::CALL:
+        case ISA::RET:
+            ready[7] = alu;
+            break;
+        case ISA::POP:
+            ready[7] = alu;
+            ready[rd] = load; // POP r7 also lands here
+            ready[FLAGS_REG] = load;
+            break;
+        case ISA::LD_ABS:
+        case ISA::LD_IND:
+        case ISA::CAS:
+        case ISA::FADD:
+            ready[rd] = load;
+            ready[FLAGS_REG] = load;
+            break;
+        default:
+            break;
+        }
+
+        // Where the next fetch comes from
+        redirect = 0;
+        redirect_cause = Fetch;
+        if (op == ISA::JMP || op == ISA::CALL)
+        {
+            redirect = id + 1;
+            redirect_cause = Jump;
+        }
+        else if (op == ISA::RET)
+        {
+            redirect = ret_predicted ? id + 1 : ex + 2;
+            redirect_cause = Return;
+        }
+        else if (op == ISA::JZ || op == ISA::JNZ || op == ISA::JC || op == ISA::JN)
+        {
+            if (branch_predicted != branch_taken)
+                redirect = ex + 1;
+            else if (branch_taken)
+                redirect = id + 1;
+            redirect_cause = Branch;
+        }
+        branch_taken = branch_predicted = ret_predicted = false;
+
+        if (gap)
+        {
+            pc_stalls[pc] += gap;
+            pc_cause[pc] = uint8_t(cause);
+        }
+        pc_execs[pc]++;
+        instructions++;
+        last_id = id;
+        last_ex = ex;
+    }
+
+    uint64_t stall_total() const
+    {
+        uint64_t t = 0;
+        for (uint64_t s : stalls)
+            t += s;
+        return t;
+    }
+
+    void report(std::ostream &o, const Symbols &sym, size_t top = 10) const
+    {
+        const uint64_t total = cycles();
+        o << "=== pipeline: " << instructions << " instructions, " << total << " cycles, CPI " << std::fixed
+          << std::setprecision(3) << cpi() << " ===\n"
+          << "  cause          cycles   of total\n";
+        for (int c = 0; c < CAUSES; ++c)
+            o << "  " << std::left << std::setw(9) << cause_name(c) << std::right << std::setw(12) << stalls[c]
+              << std::setw(10) << std::setprecision(2) << pct(stalls[c], total) << "%\n";
+        o << "  " << std::left << std::setw(9) << "total" << std::right << std::setw(12) << stall_total()
+          << std::setw(10) << pct(stall_total(), total) << "%\n"
+          << "  conditional branches " << branches << ", taken " << taken << " (" << std::setprecision(1)
+          << pct(taken, branches) << "%), mispredicted " << mispredicts << " (" << pct(mispredicts, branches)
+          << "%) by " << (predictor ? predictor->name : "nt") << "\n";
+        if (ras)
+            o << "  returns " << returns << ", RAS misses " << ras_misses << " (" << pct(ras_misses, returns) << "%)\n";
+        o << "--- top stalling PCs ---\n"
+          << "  pc           stalls     execs  stalls/exec  cause     symbol\n";
+        for (uint16_t pc : top_pcs(top))
+            o << "  " << Emu16::hex4(pc) << std::setw(13) << pc_stalls[pc] << std::setw(10) << pc_execs[pc]
+              << std::setw(13) << std::setprecision(2) << double(pc_stalls[pc]) / double(pc_execs[pc]) << "  "
+              << std::left << std::setw(9) << cause_name(pc_cause[pc]) << std::right << " " << sym.format(pc) << "\n";
+    }
+
+    void write_json(std::ostream &o, const Symbols &sym, size_t top = 64) const
+    {
+        o << "{\n  \"instructions\": " << instructions << ",\n  \"cycles\": " << cycles() << ",\n  \"cpi\": "
+          << std::fixed << std::setprecision(4) << cpi() << ",\n  \"branches\": " << branches << ",\n  \"taken\": "
+          << taken << ",\n  \"predictor\": \"" << (predictor ? predictor->name : "nt") << "\",\n  \"mispredicts\": "
+          << mispredicts << ",\n  \"returns\": " << returns << ",\n  \"ras_misses\": " << ras_misses
+          << ",\n  \"stalls\": {";
+        for (int c = 0; c < CAUSES; ++c)
+            o << (c ? ", " : "") << "\"" << cause_name(c) << "\": " << stalls[c];
+        o << "},\n  \"top_pcs\": [";
+        bool first = true;
+        for (uint16_t pc : top_pcs(top))
+        {
+            o << (first ? "\n" : ",\n") << "    {\"pc\": \"" << Emu16::hex4(pc) << "\", \"symbol\": \""
+              << json_escape(sym.format(pc)) << "\", \"stalls\": " << pc_stalls[pc] << ", \"executions\": " << pc_execs[pc]
+              << ", \"cause\": \"" << cause_name(pc_cause[pc]) << "\"}";
+            first = false;
+        }
+        o << "\n  ]\n}\n";
+    }
+
+private:
+    uint64_t ready[9] = {0}; // cycle each register (and the flags) can feed EX
+    uint64_t last_id = 0, last_ex = 0;
+    uint64_t redirect = 0;
+    int redirect_cause = Fetch; // unused while redirect is 0
+    bool branch_taken = false, branch_predicted = false, ret_predicted = false;
+
+    // By stall cycles
+    std::vector<uint16_t> top_pcs(size_t top) const
+    {
+        return ::top_pcs(top, [&](uint16_t pc)
+                         { return pc_stalls[pc]; });
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+/**
+ * Per-PC profiler (Profiler.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --profile out.json` attaches this probe: two flat 64K arrays count
+ * instructions retired and cycles consumed at every guest address. After the
+ * run the counts are grouped by label (using the asm16 --sym file when one is
+ * given), printed as a sorted hot-spot table and written as JSON. With an
+ * asm16 --map file the hottest addresses also carry their source line.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+#include "Report.cpp"
+#include "Symbols.cpp"
+
+struct Profiler : Probe
+{
+    std::vector<uint64_t> insts;
+    std::vector<uint64_t> cycles;
+
+    Profiler() : insts(65536, 0), cycles(65536, 0) {}
+
+    void on_retire(Emu16 &cpu, uint16_t pc, uint16_t, uint64_t cycles_before) override
+    {
+        insts[pc]++;
+        cycles[pc] += cpu.cycles - cycles_before;
+    }
+
+    struct Row
+    {
+        std::string name;
+        uint16_t addr = 0;
+        uint64_t insts = 0, cycles = 0;
+        std::string source; // "file:line" when known (by_pc only)
+    };
+
+    uint64_t total_cycles() const
+    {
+        uint64_t t = 0;
+        for (uint64_t c : cycles)
+            t += c;
+        return t;
+    }
+    uint64_t total_insts() const
+    {
+        uint64_t t = 0;
+        for (uint64_t c : insts)
+            t += c;
+        return t;
+    }
+
+    // Cycles and instructions summed per owning label, hottest first.
+    std::vector<Row> by_label(const Symbols &sym) const
+    {
+        std::map<std::string, Row> rows;
+        for (uint32_t pc = 0; pc < 65536; ++pc)
+        {
+            if (!insts[pc])
+                continue;
+            const auto *s = sym.lookup(uint16_t(pc));
+            std::string name = sym.owner(uint16_t(pc));
+            Row &r = rows[name];
+            r.name = name;
+            r.addr = s ? s->first : uint16_t(pc);
+            r.insts += insts[pc];
+            r.cycles += cycles[pc];
+        }
+        std::vector<Row> out;
+        for (auto &kv : rows)
+            out.push_back(kv.second);
+        std::sort(out.begin(), out.end(), [](const Row &a, const Row &b)
+                  { return a.cycles != b.cycles ? a.cycles > b.cycles : a.addr < b.addr; });
+        return out;
+    }
+
+    // Individual addresses, hottest first.
+    std::vector<Row> by_pc(const Symbols &sym) const
+    {
+        std::vector<Row> out;
+        for (uint32_t pc = 0; pc < 65536; ++pc)
+        {
+            if (insts[pc])
+                out.push_back({sym.format(uint16_t(pc)), uint16_t(pc), insts[pc], cycles[pc], sym.source(uint16_t(pc))});
+        }
+        std::sort(out.begin(), out.end(), [](const Row &a, const Row &b)
+                  { return a.cycles != b.cycles ? a.cycles > b.cycles : a.addr < b.addr; });
+        return out;
+    }
+
+    void report(std::ostream &o, const Symbols &sym, size_t top = 15) const
+    {
+        const uint64_t total = total_cycles();
+        auto line = [&](const Row &r)
+        {
+            o << "  " << std::setw(6) << std::fixed << std::setprecision(2)
+              << pct(r.cycles, total) << "%  "
+              << std::setw(12) << r.cycles << "  " << std::setw(12) << r.insts << "  "
+              << Emu16::hex4(r.addr) << "  " << r.name;
+            if (!r.source.empty())
+                o << "  (" << r.source << ")";
+            o << "\n";
+        };
+        o << "=== profile: " << total_insts() << " instructions, " << total << " cycles ===\n"
+          << "  cycles%        cycles         insts  addr    label\n";
+        auto labels = by_label(sym);
+        for (size_t i = 0; i < labels.size() && i < top; ++i)
+            line(labels[i]);
+        o << "--- hottest addresses ---\n";
+        auto pcs = by_pc(sym);
+        for (size_t i = 0; i < pcs.size() && i < top; ++i)
+            line(pcs[i]);
+    }
+
+    void write_json(std::ostream &o, const Symbols &sym) const
+    {
+        auto row = [&](const Row &r, bool last)
+        {
+            o << "    {\"addr\": " << r.addr << ", \"name\": \"" << json_escape(r.name) << "\", ";
+            if (!r.source.empty())
+                o << "\"source\": \"" << json_escape(r.source) << "\", ";
+            o << "\"instructions\": " << r.insts << ", \"cycles\": " << r.cycles << "}" << (last ? "\n" : ",\n");
+        };
+        o << "{\n  \"instructions\": " << total_insts() << ",\n  \"cycles\": " << total_cycles()
+          << ",\n  \"labels\": [\n";
+        auto labels = by_label(sym);
+        for (size_t i = 0; i < labels.size(); ++i)
+            row(labels[i], i + 1 == labels.size());
+        o << "  ],\n  \"pcs\": [\n";
+        auto pcs = by_pc(sym);
+        for (size_t i = 0; i < pcs.size(); ++i)
+            row(pcs[i], i + 1 == pcs.size());
+        o << "  ]\n}\n";
+    }
+};
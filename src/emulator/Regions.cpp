@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * Guest region report (Regions.cpp)
+ * -----------------------------------------------------------------------------
+ * A guest brackets code it wants measured with two MMIO stores:
+ *
+ *     LDI r6, kernel
+ *     ST  r6, [0xFF40]    ; REGION_BEGIN
+ *     ...                 ; measured code
+ *     ST  r6, [0xFF41]    ; REGION_END
+ *
+ * The core accumulates invocations, cycles and instructions per region id
+ * (Emu16::regions) with no probe attached. Using a label address as the id
+ * lets the asm16 --sym/--map file name the region; other ids print in hex.
+ * emu16 prints this report to stderr after the run whenever a region was
+ * marked, and --regions writes it as JSON.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+#include "Report.cpp"
+#include "Symbols.cpp"
+
+struct RegionReport
+{
+    struct Row
+    {
+        uint16_t id;
+        std::string name;
+        Emu16::RegionCount count;
+    };
+
+    // Hottest first by cycles.
+    static std::vector<Row> rows(const Emu16 &cpu, const Symbols &sym)
+    {
+        std::vector<Row> out;
+        for (const auto &kv : cpu.regions)
+            out.push_back({kv.first, sym.empty() ? Emu16::hex4(kv.first) : sym.format(kv.first), kv.second});
+        std::sort(out.begin(), out.end(), [](const Row &a, const Row &b)
+                  { return a.count.cycles != b.count.cycles ? a.count.cycles > b.count.cycles : a.id < b.id; });
+        return out;
+    }
+
+    static bool used(const Emu16 &cpu)
+    {
+        return !cpu.regions.empty() || !cpu.open_regions.empty() || cpu.region_unmatched || cpu.region_overflow;
+    }
+
+    static void report(std::ostream &o, const Emu16 &cpu, const Symbols &sym)
+    {
+        o << "=== regions";
+        if (cpu.mem.io.core_count > 1)
+            o << " (core " << cpu.core_id << ")";
+        o << ": " << cpu.cycles << " cycles total ===\n"
+          << "   cycles%        cycles  instructions   calls   cycles/call  region\n";
+        for (const Row &r : rows(cpu, sym))
+        {
+            const Emu16::RegionCount &c = r.count;
+            o << "  " << std::setw(7) << std::fixed << std::setprecision(2)
+              << pct(c.cycles, cpu.cycles) << "%"
+              << std::setw(14) << c.cycles << std::setw(14) << c.instructions << std::setw(8) << c.invocations
+              << std::setw(14) << std::setprecision(1) << (c.invocations ? double(c.cycles) / double(c.invocations) : 0.0)
+              << "  " << r.name << "\n";
+        }
+        for (const Emu16::OpenRegion &open : cpu.open_regions)
+            o << "  still open at exit: " << (sym.empty() ? Emu16::hex4(open.id) : sym.format(open.id)) << "\n";
+        if (cpu.region_unmatched)
+            o << "  " << cpu.region_unmatched << " REGION_END stores without a matching REGION_BEGIN\n";
+        if (cpu.region_overflow)
+            o << "  " << cpu.region_overflow << " REGION_BEGIN stores dropped: more than " << Emu16::MAX_OPEN_REGIONS
+              << " regions open\n";
+    }
+
+    static void write_json(std::ostream &o, const std::vector<const Emu16 *> &cores, const Symbols &sym)
+    {
+        o << "{\n  \"cores\": [";
+        for (size_t i = 0; i < cores.size(); ++i)
+        {
+            const Emu16 &cpu = *cores[i];
+            o << (i ? ",\n" : "\n") << "    {\"core\": " << cpu.core_id << ", \"cycles\": " << cpu.cycles
+              << ", \"unmatched_ends\": " << cpu.region_unmatched << ", \"dropped_begins\": " << cpu.region_overflow
+              << ", \"open_at_exit\": " << cpu.open_regions.size()
+              << ", \"regions\": [";
+            std::vector<Row> rs = rows(cpu, sym);
+            for (size_t k = 0; k < rs.size(); ++k)
+                o << (k ? ",\n" : "\n") << "      {\"id\": \"" << Emu16::hex4(rs[k].id) << "\", \"name\": \""
+                  << json_escape(rs[k].name) << "\", \"invocations\": " << rs[k].count.invocations << ", \"cycles\": "
+                  << rs[k].count.cycles << ", \"instructions\": " << rs[k].count.instructions << "}";
+            o << (rs.empty() ? "]}" : "\n    ]}");
+        }
+        o << "\n  ]\n}\n";
+    }
+};
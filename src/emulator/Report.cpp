@@ -0,0 +1,42 @@
+#pragma once
+
+/**
+ * Report helpers (Report.cpp)
+ * -----------------------------------------------------------------------------
+ * Shared by the profilers' and simulators' stderr tables and JSON:
+ * percentages that tolerate an empty denominator, and the hottest guest
+ * addresses by any per-PC key.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// a as a percentage of b; 0 when b is 0.
+inline double pct(uint64_t a, uint64_t b)
+{
+    return b ? 100.0 * double(a) / double(b) : 0.0;
+}
+
+// The `top` addresses whose key(pc) is non-zero, largest key first and
+// lowest address on ties. The key may be any ordered value, e.g. a pair to
+// break ties on a second counter.
+template <typename KeyFn>
+std::vector<uint16_t> top_pcs(size_t top, KeyFn key)
+{
+    using Key = decltype(key(uint16_t(0)));
+    std::vector<std::pair<Key, uint16_t>> v;
+    for (uint32_t pc = 0; pc < 65536; ++pc)
+    {
+        Key k = key(uint16_t(pc));
+        if (k != Key())
+            v.push_back({k, uint16_t(pc)});
+    }
+    std::sort(v.begin(), v.end(), [](const std::pair<Key, uint16_t> &a, const std::pair<Key, uint16_t> &b)
+              { return a.first != b.first ? b.first < a.first : a.second < b.second; });
+    std::vector<uint16_t> out;
+    for (size_t i = 0; i < v.size() && i < top; ++i)
+        out.push_back(v[i].second);
+    return out;
+}
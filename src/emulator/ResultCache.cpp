@@ -0,0 +1,301 @@
+#pragma once
+
+/**
+ * Content-addressed result cache (ResultCache.cpp)
+ * -----------------------------------------------------------------------------
+ * Emu16 is deterministic given the image, the input patches and the cycle
+ * limit, so a finished JobResult can be reused by any later run with the same
+ * inputs. Entries live in one directory, one file per result, named by a
+ * 128-bit digest of:
+ *
+ *     EMU16_VERSION | image words | patches | cycle limit
+ *
+ * Concurrency: writers build the entry in a private temp file and rename() it
+ * into place, so readers see either nothing or a complete file. Every entry
+ * carries its own key and a trailing checksum; anything that fails to parse
+ * is treated as a miss and simply re-run. Eviction removes the least recently
+ * used entries (lookups bump the file mtime) once the directory holds more
+ * than max_entries results; losing a race with another evicter is harmless.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "Emu16.cpp"
+#include "Job.cpp"
+
+// [Digest] Two independent 64-bit lanes: FNV-1a and a multiply-xorshift mix
+struct Digest
+{
+    uint64_t a = 0xCBF29CE484222325ull;
+    uint64_t b = 0x6A09E667F3BCC909ull;
+
+    void update(const void *data, size_t n)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < n; ++i)
+        {
+            a = (a ^ p[i]) * 0x100000001B3ull;
+            b = (b ^ p[i]) * 0x9E3779B97F4A7C15ull;
+            b ^= b >> 29;
+        }
+    }
+    void update_u64(uint64_t v)
+    {
+        uint8_t le[8];
+        for (int i = 0; i < 8; i++)
+            le[i] = uint8_t(v >> (8 * i));
+        update(le, sizeof(le));
+    }
+    void update_words(const std::vector<uint16_t> &w)
+    {
+        update_u64(w.size());
+        for (uint16_t v : w)
+        {
+            uint8_t le[2] = {uint8_t(v), uint8_t(v >> 8)};
+            update(le, 2);
+        }
+    }
+    std::string hex() const
+    {
+        static const char *digits = "0123456789abcdef";
+        std::string s;
+        for (uint64_t v : {a, b})
+            for (int i = 60; i >= 0; i -= 4)
+                s.push_back(digits[(v >> i) & 0xF]);
+        return s;
+    }
+};
+
+static inline Digest image_digest(const std::vector<uint16_t> &image)
+{
+    Digest d;
+    d.update_words(image);
+    return d;
+}
+
+// [Capture] streambuf that forwards to two sinks (live console + cache copy)
+struct TeeBuf : std::streambuf
+{
+    std::streambuf *first, *second;
+    TeeBuf(std::streambuf *a, std::streambuf *b) : first(a), second(b) {}
+    int overflow(int c) override
+    {
+        if (traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+        bool ok = !traits_type::eq_int_type(first->sputc(char(c)), traits_type::eof());
+        ok = !traits_type::eq_int_type(second->sputc(char(c)), traits_type::eof()) && ok;
+        return ok ? c : traits_type::eof();
+    }
+    int sync() override
+    {
+        return (first->pubsync() == 0 && second->pubsync() == 0) ? 0 : -1;
+    }
+};
+
+// [ResultCache] Directory of <key>.e16r files
+class ResultCache
+{
+public:
+    static constexpr uint64_t DEFAULT_MAX_ENTRIES = 4096;
+
+    ResultCache(const std::string &dir_, uint64_t max_entries_ = DEFAULT_MAX_ENTRIES)
+        : dir(dir_), max_entries(max_entries_)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+    }
+
+    static std::string key(const Digest &image, const Job &job)
+    {
+        Digest d;
+        d.update(EMU16_VERSION, std::char_traits<char>::length(EMU16_VERSION));
+        d.update_u64(image.a);
+        d.update_u64(image.b);
+        d.update_u64(job.patches.size());
+        for (const auto &p : job.patches)
+        {
+            d.update_u64(p.first);
+            d.update_words(p.second);
+        }
+        d.update_u64(job.cycle_limit);
+        return d.hex();
+    }
+
+    bool lookup(const std::string &key, JobResult &res)
+    {
+        std::filesystem::path p = entry_path(key);
+        std::ifstream f(p, std::ios::binary);
+        if (!f)
+            return false;
+        std::string blob((std::istreambuf_iterator<char>(f)), {});
+        if (!decode(blob, key, res))
+            return false;
+        std::error_code ec;
+        std::filesystem::last_write_time(p, std::filesystem::file_time_type::clock::now(), ec);
+        return true;
+    }
+
+    void store(const std::string &key, const JobResult &res)
+    {
+        std::ostringstream tag;
+        tag << ".tmp-" << std::this_thread::get_id() << "-"
+            << std::chrono::steady_clock::now().time_since_epoch().count();
+        std::filesystem::path tmp = dir / (key + tag.str());
+        {
+            std::ofstream f(tmp, std::ios::binary);
+            if (!f)
+                return;
+            std::string blob = encode(key, res);
+            f.write(blob.data(), std::streamsize(blob.size()));
+            if (!f)
+            {
+                f.close();
+                std::error_code ec;
+                std::filesystem::remove(tmp, ec);
+                return;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, entry_path(key), ec);
+        if (ec)
+            std::filesystem::remove(tmp, ec);
+        evict();
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'E', '1', '6', 'R', 'C', '0', '0', '1'};
+
+    std::filesystem::path dir;
+    uint64_t max_entries;
+
+    std::filesystem::path entry_path(const std::string &key) const
+    {
+        return dir / (key + ".e16r");
+    }
+
+    static void put(std::string &s, uint64_t v, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            s.push_back(char(uint8_t(v >> (8 * i))));
+    }
+    static bool get(const std::string &s, size_t &at, uint64_t &v, int bytes)
+    {
+        if (at + size_t(bytes) > s.size())
+            return false;
+        v = 0;
+        for (int i = 0; i < bytes; i++)
+            v |= uint64_t(uint8_t(s[at + i])) << (8 * i);
+        at += size_t(bytes);
+        return true;
+    }
+    static uint64_t checksum(const std::string &s, size_t n)
+    {
+        Digest d;
+        d.update(s.data(), n);
+        return d.a;
+    }
+
+    static std::string encode(const std::string &key, const JobResult &r)
+    {
+        std::string s(MAGIC, sizeof(MAGIC));
+        put(s, key.size(), 4);
+        s += key;
+        put(s, r.status.size(), 1);
+        s += r.status;
+        put(s, r.cycles, 8);
+        for (int i = 0; i < 8; i++)
+            put(s, r.R[i], 2);
+        put(s, r.PC, 2);
+        put(s, (r.F.N << 3) | (r.F.Z << 2) | (r.F.C << 1) | int(r.F.V), 1);
+        put(s, r.output.size(), 4);
+        s += r.output;
+        put(s, r.memory.size(), 4);
+        for (const auto &w : r.memory)
+        {
+            put(s, w.first, 2);
+            put(s, w.second, 2);
+        }
+        put(s, checksum(s, s.size()), 8);
+        return s;
+    }
+
+    static bool decode(const std::string &s, const std::string &key, JobResult &r)
+    {
+        size_t at = sizeof(MAGIC);
+        uint64_t v = 0, n = 0;
+        if (s.size() < sizeof(MAGIC) + 8 || s.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0)
+            return false;
+        size_t body = s.size() - 8, tail = body;
+        if (!get(s, tail, v, 8) || v != checksum(s, body))
+            return false;
+        if (!get(s, at, n, 4) || at + n > body || s.compare(at, n, key) != 0)
+            return false;
+        at += n;
+        if (!get(s, at, n, 1) || at + n > body)
+            return false;
+        r.status = s.substr(at, n);
+        at += n;
+        if (!get(s, at, r.cycles, 8))
+            return false;
+        for (int i = 0; i < 8; i++)
+        {
+            if (!get(s, at, v, 2))
+                return false;
+            r.R[i] = uint16_t(v);
+        }
+        if (!get(s, at, v, 2))
+            return false;
+        r.PC = uint16_t(v);
+        if (!get(s, at, v, 1))
+            return false;
+        r.F.N = (v >> 3) & 1;
+        r.F.Z = (v >> 2) & 1;
+        r.F.C = (v >> 1) & 1;
+        r.F.V = v & 1;
+        if (!get(s, at, n, 4) || at + n > body)
+            return false;
+        r.output = s.substr(at, n);
+        at += n;
+        if (!get(s, at, n, 4) || at + n * 4 != body)
+            return false;
+        r.memory.clear();
+        r.memory.reserve(n);
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            uint64_t addr = 0, val = 0;
+            get(s, at, addr, 2);
+            get(s, at, val, 2);
+            r.memory.push_back({uint16_t(addr), uint16_t(val)});
+        }
+        return true;
+    }
+
+    void evict()
+    {
+        std::error_code ec;
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> entries;
+        for (const auto &e : std::filesystem::directory_iterator(dir, ec))
+        {
+            if (e.path().extension() != ".e16r")
+                continue;
+            std::error_code tec;
+            auto t = e.last_write_time(tec);
+            if (!tec)
+                entries.push_back({t, e.path()});
+        }
+        if (entries.size() <= max_entries)
+            return;
+        std::sort(entries.begin(), entries.end());
+        size_t excess = entries.size() - max_entries;
+        for (size_t i = 0; i < excess; ++i)
+            std::filesystem::remove(entries[i].second, ec);
+    }
+};
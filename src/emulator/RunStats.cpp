@@ -0,0 +1,140 @@
+#pragma once
+
+/**
+ * Run statistics summary (RunStats.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --stats-json out.json` times the run on the host and writes one JSON
+ * object a dashboard can ingest per program:
+ *
+ *   • guest instructions retired and cycles (summed over cores),
+ *   • host wall time, process CPU time, MIPS (instructions per wall second),
+ *   • host time per guest cycle, and host TSC ticks per guest cycle on x86,
+ *   • reads and writes per MMIO device,
+ *   • peak stack depth per core (lowest SP reached by PUSH/CALL).
+ *
+ * Nothing here is a probe: the core always keeps `retired`, `sp_low` and the
+ * MMIO counters, so the plain loop runs while being measured. Timing covers
+ * execution only, not loading or writing results.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define EMU16_HAVE_TSC 1
+#endif
+
+struct RunStats
+{
+    void start()
+    {
+        wall0 = std::chrono::steady_clock::now();
+        cpu0 = std::clock();
+#ifdef EMU16_HAVE_TSC
+        tsc0 = __rdtsc();
+#endif
+    }
+
+    void stop()
+    {
+        wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+        cpu = double(std::clock() - cpu0) / CLOCKS_PER_SEC;
+#ifdef EMU16_HAVE_TSC
+        tsc = __rdtsc() - tsc0;
+#endif
+    }
+
+    void write_json(std::ostream &o, const std::vector<const Emu16 *> &cores, const MMIO &io,
+                    const std::string &status) const
+    {
+        uint64_t insts = 0, cycles = 0;
+        for (const Emu16 *c : cores)
+        {
+            insts += c->retired;
+            cycles += c->cycles;
+        }
+        o << std::fixed << std::setprecision(6)
+          << "{\n  \"version\": \"" << EMU16_VERSION << "\",\n  \"status\": \"" << status
+          << "\",\n  \"cores\": " << cores.size()
+          << ",\n  \"instructions\": " << insts << ",\n  \"cycles\": " << cycles
+          << ",\n  \"wall_seconds\": " << wall << ",\n  \"cpu_seconds\": " << cpu
+          << ",\n  \"mips\": " << (wall > 0 ? double(insts) / wall / 1e6 : 0.0)
+          << ",\n  \"host_ns_per_guest_cycle\": " << (cycles ? wall * 1e9 / double(cycles) : 0.0)
+          << ",\n  \"host_cycles_per_guest_cycle\": ";
+#ifdef EMU16_HAVE_TSC
+        o << (cycles ? double(tsc) / double(cycles) : 0.0);
+#else
+        o << "null";
+#endif
+        o << ",\n  \"mmio\": {";
+        bool first = true;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint64_t r = io.reads[i].load(std::memory_order_relaxed), w = io.writes[i].load(std::memory_order_relaxed);
+            if (!r && !w)
+                continue;
+            o << (first ? "\n" : ",\n") << "    \"" << device_name(uint16_t(0xFF00 | i)) << "\": {\"addr\": \""
+              << Emu16::hex4(uint16_t(0xFF00 | i)) << "\", \"reads\": " << r << ", \"writes\": " << w << "}";
+            first = false;
+        }
+        o << (first ? "}" : "\n  }") << ",\n  \"peak_stack_depth\": " << peak_depth(cores) << ",\n  \"per_core\": [";
+        for (size_t i = 0; i < cores.size(); ++i)
+        {
+            const Emu16 &c = *cores[i];
+            o << (i ? ",\n" : "\n") << "    {\"core\": " << c.core_id << ", \"instructions\": " << c.retired
+              << ", \"cycles\": " << c.cycles << ", \"peak_stack_depth\": " << depth(c)
+              << ", \"sp\": \"" << Emu16::hex4(c.R[7]) << "\"}";
+        }
+        o << "\n  ]\n}\n";
+    }
+
+private:
+    std::chrono::steady_clock::time_point wall0;
+    std::clock_t cpu0 = 0;
+    double wall = 0, cpu = 0;
+    uint64_t tsc0 = 0, tsc = 0;
+
+    static uint32_t depth(const Emu16 &c)
+    {
+        return c.sp_low <= c.sp_top ? uint32_t(c.sp_top - c.sp_low) : 0;
+    }
+    static uint32_t peak_depth(const std::vector<const Emu16 *> &cores)
+    {
+        uint32_t d = 0;
+        for (const Emu16 *c : cores)
+            d = std::max(d, depth(*c));
+        return d;
+    }
+
+    static std::string device_name(uint16_t addr)
+    {
+        switch (addr)
+        {
+        case 0xFF00:
+            return "TX_CHAR";
+        case 0xFF10:
+            return "TX_STR_ADDR";
+        case 0xFF12:
+            return "TX_INT";
+        case 0xFF20:
+            return "TIMER";
+        case 0xFF30:
+            return "CORE_ID";
+        case 0xFF31:
+            return "CORE_COUNT";
+        case Emu16::REGION_BEGIN:
+            return "REGION_BEGIN";
+        case Emu16::REGION_END:
+            return "REGION_END";
+        default:
+            return Emu16::hex4(addr);
+        }
+    }
+};
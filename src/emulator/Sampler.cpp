@@ -0,0 +1,236 @@
+#pragma once
+
+/**
+ * Sampling profiler (Sampler.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --sample out.folded [--sample-hz N]` profiles without attaching a
+ * probe: setting shadow_calls switches the core to its instrumented
+ * instruction body, minus probe dispatch. A per-thread CPU-time
+ * POSIX timer delivers SIGPROF to the emulating thread N times per second;
+ * the handler copies Emu16::cur_pc and the core's shadow call stack into the
+ * next slot of a preallocated sample buffer and returns. Nothing is
+ * allocated or formatted until the run is over.
+ *
+ * Between samples the only costs are that body's store of cur_pc on every
+ * instruction and a shadow stack push/pop per CALL/RET. Results are
+ * statistical: a function's share of samples estimates its share of time.
+ * Only one Sampler can be active per process.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+#include "Report.cpp"
+#include "Symbols.cpp"
+
+#ifdef __linux__
+#include <csignal>
+#include <ctime>
+#include <sys/syscall.h>
+#include <unistd.h>
+// glibc before 2.35 has the member but not this portable name.
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+class Sampler
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1u << 16;
+    static constexpr unsigned DEFAULT_HZ = 1000;
+
+    struct Sample
+    {
+        uint16_t pc;
+        uint32_t depth; // full depth; only the outermost SHADOW_MAX are stored
+        uint16_t stack[Emu16::SHADOW_MAX];
+    };
+
+    uint64_t dropped = 0; // samples that did not fit in the buffer
+
+    explicit Sampler(size_t capacity = DEFAULT_CAPACITY) : samples(capacity) {}
+    ~Sampler()
+    {
+        stop();
+    }
+
+    // Start sampling `cpu`, which must run on the calling thread.
+    bool start(Emu16 &cpu, unsigned hz, std::string &err)
+    {
+#ifdef __linux__
+        if (active.load())
+        {
+            err = "another sampler is already running";
+            return false;
+        }
+        if (hz == 0 || hz > 100000)
+        {
+            err = "sample rate must be 1..100000 Hz";
+            return false;
+        }
+        this->cpu = &cpu;
+        entry = cpu.PC;
+        cpu.shadow_calls = true;
+        struct sigaction sa = {};
+        sa.sa_handler = &Sampler::on_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGPROF, &sa, &old_action);
+        active.store(this);
+
+        struct sigevent sev = {};
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = SIGPROF;
+        sev.sigev_notify_thread_id = pid_t(syscall(SYS_gettid));
+        if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &timer) != 0)
+        {
+            err = "timer_create failed";
+            active.store(nullptr);
+            sigaction(SIGPROF, &old_action, nullptr);
+            cpu.shadow_calls = false;
+            return false;
+        }
+        struct itimerspec its = {};
+        its.it_interval.tv_sec = time_t(1 / hz);
+        its.it_interval.tv_nsec = long(1000000000ull / hz % 1000000000ull);
+        its.it_value = its.it_interval;
+        timer_settime(timer, 0, &its, nullptr);
+        running = true;
+        return true;
+#else
+        (void)cpu;
+        (void)hz;
+        err = "sampling needs Linux POSIX per-thread timers";
+        return false;
+#endif
+    }
+
+    void stop()
+    {
+#ifdef __linux__
+        if (!running)
+            return;
+        timer_delete(timer);
+        active.store(nullptr);
+        sigaction(SIGPROF, &old_action, nullptr);
+        cpu->shadow_calls = false;
+        running = false;
+#endif
+    }
+
+    size_t size() const
+    {
+        return count.load();
+    }
+
+    // Flat profile: where samples landed (self) and which functions were on
+    // the stack (inclusive, counted once per sample), hottest first.
+    void report(std::ostream &o, const Symbols &sym, size_t top = 15) const
+    {
+        const size_t n = size();
+        std::map<std::string, uint64_t> self, incl, pcs;
+        std::vector<std::string> path;
+        for (size_t i = 0; i < n; ++i)
+        {
+            frames(samples[i], sym, path);
+            self[path.back()]++;
+            std::sort(path.begin(), path.end());
+            path.erase(std::unique(path.begin(), path.end()), path.end());
+            for (const std::string &f : path)
+                incl[f]++;
+            pcs[sym.format(samples[i].pc)]++;
+        }
+        auto table = [&](const char *title, const std::map<std::string, uint64_t> &m)
+        {
+            std::vector<std::pair<uint64_t, std::string>> rows;
+            for (const auto &kv : m)
+                rows.push_back({kv.second, kv.first});
+            std::sort(rows.begin(), rows.end(), [](const std::pair<uint64_t, std::string> &a, const std::pair<uint64_t, std::string> &b)
+                      { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+            o << "--- " << title << " ---\n";
+            for (size_t i = 0; i < rows.size() && i < top; ++i)
+                o << "  " << std::setw(6) << std::fixed << std::setprecision(2)
+                  << pct(rows[i].first, n) << "%  "
+                  << std::setw(8) << rows[i].first << "  " << rows[i].second << "\n";
+        };
+        o << "=== sampling profile: " << n << " samples";
+        if (dropped)
+            o << " (" << dropped << " dropped, buffer full)";
+        o << " ===\n";
+        table("self (function executing)", self);
+        table("inclusive (function on stack)", incl);
+        table("hottest addresses", pcs);
+    }
+
+    // Folded call paths ("start;fib;fib <samples>") for flame graph tools.
+    void write_folded(std::ostream &o, const Symbols &sym) const
+    {
+        std::map<std::string, uint64_t> paths;
+        std::vector<std::string> path;
+        for (size_t i = 0; i < size(); ++i)
+        {
+            frames(samples[i], sym, path);
+            std::string line;
+            for (size_t k = 0; k < path.size(); ++k)
+                line += (k ? ";" : "") + path[k];
+            paths[line]++;
+        }
+        for (const auto &kv : paths)
+            o << kv.first << " " << kv.second << "\n";
+    }
+
+private:
+    static inline std::atomic<Sampler *> active{nullptr};
+
+    std::vector<Sample> samples;
+    std::atomic<size_t> count{0};
+    Emu16 *cpu = nullptr;
+    uint16_t entry = 0;
+    bool running = false;
+#ifdef __linux__
+    timer_t timer{};
+    struct sigaction old_action = {};
+#endif
+
+    // Outermost first: entry point, then every stored shadow frame. Frames
+    // beyond SHADOW_MAX are summarized as one "..." entry.
+    void frames(const Sample &s, const Symbols &sym, std::vector<std::string> &out) const
+    {
+        out.clear();
+        out.push_back(sym.owner(entry));
+        uint32_t kept = std::min<uint32_t>(s.depth, Emu16::SHADOW_MAX);
+        for (uint32_t i = 0; i < kept; ++i)
+            out.push_back(sym.owner(s.stack[i]));
+        if (s.depth > kept)
+            out.push_back("...");
+    }
+
+    static void on_signal(int)
+    {
+        Sampler *s = active.load(std::memory_order_relaxed);
+        if (!s)
+            return;
+        size_t i = s->count.load(std::memory_order_relaxed);
+        if (i >= s->samples.size())
+        {
+            s->dropped++;
+            return;
+        }
+        Emu16 &cpu = *s->cpu;
+        Sample &x = s->samples[i];
+        x.pc = cpu.cur_pc.load(std::memory_order_relaxed);
+        x.depth = cpu.shadow_depth.load(std::memory_order_relaxed);
+        std::atomic_signal_fence(std::memory_order_acquire);
+        uint32_t kept = std::min<uint32_t>(x.depth, Emu16::SHADOW_MAX);
+        for (uint32_t k = 0; k < kept; ++k)
+            x.stack[k] = cpu.shadow_func[k];
+        s->count.store(i + 1, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,350 @@
+#pragma once
+
+/**
+ * Emulator service (Server.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --serve <socket>` keeps a process alive on a Unix domain socket so
+ * short jobs pay for execution only, not for process startup, 128 KB memory
+ * zeroing and image loading:
+ *   • Images are loaded once and cached (keyed by path, reloaded on mtime
+ *     change) as a ready-to-run Snapshot of the reset machine.
+ *   • Emu16 instances are preallocated into a pool. Returning an instance to
+ *     a snapshot it already ran only copies back the pages the job dirtied.
+ *   • One thread per client connection; a connection may send many jobs.
+ *
+ * Protocol (text lines, numbers decimal or 0x-hex):
+ *
+ *   request                       reply
+ *   -------                       -----
+ *   image <path>                  status halted|budget|fault|error [<msg>]
+ *   cycles <limit>                cycles <n>
+ *   patch <addr> <w0> [w1 ...]    regs <r0> .. <r7> <pc> <flags>
+ *   dump <addr> <len>             output <nbytes>
+ *   end                           <nbytes raw console bytes>
+ *                                 dump <addr> <value>   (non-zero words only)
+ *                                 end
+ *
+ * `patch` and `dump` may repeat; `cycles` defaults to DEFAULT_CYCLE_LIMIT.
+ * With --cache-dir, jobs are answered from the shared ResultCache when an
+ * identical run (same image words, patches and limit) is already stored.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Emu16.cpp"
+#include "Job.cpp"
+#include "Loader.cpp"
+#include "ResultCache.cpp"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// [ImageCache] path -> reset machine state with the image loaded
+class ImageCache
+{
+public:
+    struct Entry
+    {
+        std::filesystem::file_time_type mtime;
+        Snapshot snap;
+        Digest digest; // of the image file words, for result cache keys
+    };
+
+    // Returns nullptr if the image cannot be read.
+    std::shared_ptr<const Entry> get(const std::string &path)
+    {
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec)
+            return nullptr;
+        {
+            std::lock_guard<std::mutex> g(lock);
+            auto it = images.find(path);
+            if (it != images.end() && it->second->mtime == mtime)
+                return it->second;
+        }
+        std::vector<uint16_t> rom;
+        if (!load_image(path, rom))
+            return nullptr;
+        Emu16 scratch(false);
+        scratch.load(rom, 0x0000);
+        scratch.reset();
+        auto e = std::make_shared<Entry>();
+        e->mtime = mtime;
+        e->snap = scratch.snapshot();
+        e->digest = image_digest(rom);
+        std::lock_guard<std::mutex> g(lock);
+        images[path] = e;
+        return e;
+    }
+
+private:
+    std::mutex lock;
+    std::map<std::string, std::shared_ptr<const Entry>> images;
+};
+
+// [InstancePool] Preallocated, reusable cores
+class InstancePool
+{
+public:
+    explicit InstancePool(unsigned n)
+    {
+        for (unsigned i = 0; i < n; ++i)
+            idle.push_back(make());
+    }
+    std::unique_ptr<Emu16> acquire()
+    {
+        std::lock_guard<std::mutex> g(lock);
+        if (idle.empty())
+            return make();
+        std::unique_ptr<Emu16> e = std::move(idle.back());
+        idle.pop_back();
+        return e;
+    }
+    void release(std::unique_ptr<Emu16> e)
+    {
+        e->mem.io.out = nullptr;
+        std::lock_guard<std::mutex> g(lock);
+        idle.push_back(std::move(e));
+    }
+
+private:
+    static std::unique_ptr<Emu16> make()
+    {
+        std::unique_ptr<Emu16> e(new Emu16(false));
+        e->mem.track_dirty = true;
+        e->mem.io.out = nullptr;
+        e->report_faults = false;
+        return e;
+    }
+    std::mutex lock;
+    std::vector<std::unique_ptr<Emu16>> idle;
+};
+
+// [Execution] Run one job on a pooled instance (or answer it from the cache)
+static bool run_job(const Job &job, ImageCache &images, InstancePool &pool, ResultCache *cache, JobResult &res, std::string &err)
+{
+    auto img = images.get(job.image);
+    if (!img)
+    {
+        err = "cannot read image " + job.image;
+        return false;
+    }
+    std::string key;
+    if (cache)
+    {
+        key = ResultCache::key(img->digest, job);
+        if (cache->lookup(key, res))
+            return true;
+    }
+    std::unique_ptr<Emu16> emu = pool.acquire();
+    emu->restore(img->snap);
+    apply_patches(*emu, job);
+    std::ostringstream out;
+    emu->mem.io.out = &out;
+    run_job_cycles(*emu, job.cycle_limit);
+    collect_result(*emu, job, out.str(), res, cache != nullptr);
+    pool.release(std::move(emu));
+    if (cache)
+        cache->store(key, res);
+    return true;
+}
+
+#ifndef _WIN32
+
+// [Wire] Buffered line reader and full writes over a socket fd
+struct Conn
+{
+    int fd;
+    std::string buf;
+
+    bool read_line(std::string &line)
+    {
+        for (;;)
+        {
+            size_t nl = buf.find('\n');
+            if (nl != std::string::npos)
+            {
+                line = buf.substr(0, nl);
+                buf.erase(0, nl + 1);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                return true;
+            }
+            char tmp[4096];
+            ssize_t n = ::read(fd, tmp, sizeof(tmp));
+            if (n <= 0)
+                return false;
+            buf.append(tmp, size_t(n));
+        }
+    }
+    bool write_all(const std::string &s)
+    {
+        size_t off = 0;
+        while (off < s.size())
+        {
+            ssize_t n = ::write(fd, s.data() + off, s.size() - off);
+            if (n <= 0)
+                return false;
+            off += size_t(n);
+        }
+        return true;
+    }
+};
+
+static bool parse_job_line(const std::string &line, Job &job, std::string &err)
+{
+    std::istringstream in(line);
+    std::string key;
+    in >> key;
+    std::vector<uint64_t> nums;
+    std::string tok;
+    if (key == "image")
+    {
+        std::getline(in >> std::ws, job.image);
+        if (job.image.empty())
+        {
+            err = "image needs a path";
+            return false;
+        }
+        return true;
+    }
+    while (in >> tok)
+    {
+        char *end = nullptr;
+        unsigned long long v = std::strtoull(tok.c_str(), &end, 0);
+        if (!end || *end)
+        {
+            err = "bad number '" + tok + "'";
+            return false;
+        }
+        nums.push_back(v);
+    }
+    if (key == "cycles" && nums.size() == 1)
+        job.cycle_limit = nums[0];
+    else if (key == "patch" && nums.size() >= 2)
+        job.patches.push_back({uint16_t(nums[0]), std::vector<uint16_t>(nums.begin() + 1, nums.end())});
+    else if (key == "dump" && nums.size() == 2)
+        job.dumps.push_back({uint16_t(nums[0]), uint32_t(nums[1])});
+    else
+    {
+        err = "bad request line '" + line + "'";
+        return false;
+    }
+    return true;
+}
+
+static std::string format_reply(const Job &job, const JobResult &r)
+{
+    std::ostringstream o;
+    o << "status " << r.status << "\n"
+      << "cycles " << r.cycles << "\n"
+      << "regs";
+    for (int i = 0; i < 8; i++)
+        o << " " << Emu16::hex4(r.R[i]);
+    o << " " << Emu16::hex4(r.PC) << " " << flags_str(r.F) << "\n"
+      << "output " << r.output.size() << "\n"
+      << r.output;
+    for (const auto &w : r.memory)
+    {
+        for (const auto &d : job.dumps)
+        {
+            if (w.first >= d.first && uint32_t(w.first) < uint32_t(d.first) + d.second)
+            {
+                o << "dump " << Emu16::hex4(w.first) << " " << Emu16::hex4(w.second) << "\n";
+                break;
+            }
+        }
+    }
+    o << "end\n";
+    return o.str();
+}
+
+static void serve_connection(int fd, ImageCache &images, InstancePool &pool, ResultCache *cache)
+{
+    Conn c{fd, {}};
+    std::string line, err;
+    Job job;
+    bool bad = false;
+    while (c.read_line(line))
+    {
+        if (line.empty())
+            continue;
+        if (line != "end")
+        {
+            if (!bad && !parse_job_line(line, job, err))
+                bad = true;
+            continue;
+        }
+        JobResult res;
+        if (!bad && job.image.empty())
+        {
+            err = "missing image";
+            bad = true;
+        }
+        if (!bad && !run_job(job, images, pool, cache, res, err))
+            bad = true;
+        if (!c.write_all(bad ? "status error " + err + "\nend\n" : format_reply(job, res)))
+            break;
+        job = Job{};
+        bad = false;
+    }
+    ::close(fd);
+}
+
+static inline int run_server(const std::string &path, unsigned pool_size, ResultCache *cache)
+{
+    std::signal(SIGPIPE, SIG_IGN);
+    int ls = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (ls < 0 || path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Cannot create socket " << path << "\n";
+        return 1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    ::unlink(path.c_str());
+    if (::bind(ls, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(ls, 64) < 0)
+    {
+        std::cerr << "Cannot listen on " << path << "\n";
+        ::close(ls);
+        return 1;
+    }
+
+    ImageCache images;
+    InstancePool pool(pool_size);
+    std::cerr << "emu16: serving on " << path << " (pool " << pool_size << ")\n";
+    for (;;)
+    {
+        int fd = ::accept(ls, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        std::thread([fd, &images, &pool, cache]
+                    { serve_connection(fd, images, pool, cache); })
+            .detach();
+    }
+}
+
+#else
+
+static inline int run_server(const std::string &, unsigned, ResultCache *)
+{
+    std::cerr << "--serve needs Unix domain sockets and is not available on this platform\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,506 @@
+#pragma once
+
+/**
+ * Sampled simulation (SimPoint.cpp)
+ * -----------------------------------------------------------------------------
+ * SimPoint-style sampling, so a slow timing model only has to simulate a few
+ * representative slices of a long program:
+ *
+ *   1) profile   BbvProfiler runs the whole program once and records a
+ *                basic-block vector per interval of N instructions (block
+ *                start PC -> instructions executed in that block); an
+ *                instruction or cycle budget ends "the whole program" early,
+ *   2) cluster   the normalized vectors are randomly projected to 15
+ *                dimensions and clustered with k-means; k is the smallest
+ *                value whose BIC reaches 90% of the best seen up to max_k,
+ *   3) pick      per cluster the interval closest to its centroid is the
+ *                simulation point, weighted by the cluster's instructions,
+ *   4) checkpoint the plain loop fast-forwards to each point's first
+ *                instruction and snapshots the machine,
+ *   5) simulate  the timing model runs one interval from each checkpoint;
+ *                total cycles = sum(weight_i * CPI_i).
+ *
+ * Timing models implement "advance the core by n instructions and return the
+ * cycles that took"; `emu16` is the core's own cycle count, `micro` the
+ * datapath clocks of the microcoded sequencer (Microcode.cpp) and `pipeline`
+ * the five-stage model (Pipeline.cpp).
+ * Checkpoints can be written to a directory and simulated later, with any
+ * model, without re-profiling.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Emu16.cpp"
+#include "Microcode.cpp"
+#include "Pipeline.cpp"
+
+// Basic-block vectors per fixed-length interval of retired instructions. A
+// block ends at every JMP/Jcc/CALL/RET (taken or not) and at an interval edge.
+struct BbvProfiler : Probe
+{
+    using Vector = std::unordered_map<uint16_t, uint32_t>;
+
+    explicit BbvProfiler(uint64_t interval_) : interval(interval_) {}
+
+    uint64_t interval;
+    std::vector<Vector> bbvs;
+    std::vector<uint64_t> insts;        // instructions per interval (last may be short)
+    std::vector<uint64_t> start_cycles; // core cycles at each interval's first instruction
+
+    void on_flow(Emu16 &, Flow, uint16_t, uint16_t, bool) override
+    {
+        block_end = true;
+    }
+
+    void on_retire(Emu16 &, uint16_t pc, uint16_t, uint64_t cycles_before) override
+    {
+        if (count == 0)
+            start_cycles.push_back(cycles_before);
+        if (len == 0)
+            block = pc;
+        len++;
+        count++;
+        if (block_end)
+        {
+            cur[block] += len;
+            len = 0;
+            block_end = false;
+        }
+        if (count == interval)
+            close();
+    }
+
+    // Flush the trailing partial interval after the run.
+    void finish()
+    {
+        if (count)
+            close();
+    }
+
+private:
+    Vector cur;
+    uint16_t block = 0;
+    uint32_t len = 0;
+    uint64_t count = 0;
+    bool block_end = false;
+
+    void close()
+    {
+        if (len)
+            cur[block] += len;
+        len = 0;
+        bbvs.push_back(std::move(cur));
+        cur.clear();
+        insts.push_back(count);
+        count = 0;
+    }
+};
+
+// Cycles a timing model charges for the next n instructions of the core it
+// advances. The model may keep its own microarchitectural state per call.
+struct TimingModel
+{
+    const char *name;
+    const char *what;
+    std::function<uint64_t(Emu16 &, uint64_t instructions)> run;
+};
+
+struct SimPoints
+{
+    struct Point
+    {
+        uint32_t interval = 0;   // index of the representative interval
+        uint64_t start = 0;      // instructions retired before it
+        uint64_t start_cycle = 0;
+        uint64_t length = 0;     // instructions in it
+        uint64_t weight = 0;     // instructions its cluster stands for
+    };
+
+    struct Checkpoint
+    {
+        Point point;
+        Snapshot snap;
+    };
+
+    static constexpr unsigned DIMS = 15;
+
+    uint64_t interval = 0;
+    uint64_t total_insts = 0;
+    uint64_t total_cycles = 0; // core cycles of the profiling run
+    bool truncated = false;    // the profiling run hit its budget before HALT
+    unsigned k = 0;
+    std::vector<Point> points;
+    std::vector<uint32_t> cluster; // per interval
+
+    static const std::vector<TimingModel> &models()
+    {
+        static const std::vector<TimingModel> list = {
+            {"emu16", "the core's own cycle count",
+             [](Emu16 &e, uint64_t n)
+             {
+                 uint64_t c0 = e.cycles, end = e.retired + n;
+                 while (!e.halted && e.retired < end)
+                     e.step();
+                 return e.cycles - c0;
+             }},
+            {"micro", "datapath clocks of the microcoded sequencer",
+             [](Emu16 &e, uint64_t n)
+             {
+                 MicroEngine m;
+                 return m.run_instructions(e, n);
+             }},
+            {"pipeline", "five-stage in-order pipeline with forwarding",
+             [](Emu16 &e, uint64_t n)
+             {
+                 Pipeline p;
+                 uint64_t end = e.retired + n;
+                 e.attach(&p);
+                 while (!e.halted && e.retired < end)
+                     e.step();
+                 e.detach(&p);
+                 return p.cycles();
+             }},
+        };
+        return list;
+    }
+
+    static const TimingModel *find_model(const std::string &name)
+    {
+        for (const TimingModel &m : models())
+            if (name == m.name)
+                return &m;
+        return nullptr;
+    }
+
+    // Steps 1-3 on a freshly reset core with the program loaded. The run
+    // ends at HALT or at whichever budget comes first; every later step
+    // then treats that point as the end of the program.
+    void profile(Emu16 &emu, uint64_t interval_, unsigned max_k, unsigned fixed_k, uint64_t seed,
+                 uint64_t max_insts = UINT64_MAX, uint64_t max_cycles = UINT64_MAX)
+    {
+        interval = interval_;
+        BbvProfiler bbv(interval);
+        emu.attach(&bbv);
+        // Every instruction takes at least a cycle, so a slice of `left`
+        // cycles never retires more than `left` instructions.
+        while (!emu.halted && emu.retired < max_insts && emu.cycles < max_cycles)
+            emu.run_for(std::min(max_cycles - emu.cycles, max_insts - emu.retired));
+        emu.detach(&bbv);
+        bbv.finish();
+        truncated = !emu.halted;
+        total_insts = emu.retired;
+        total_cycles = emu.cycles;
+
+        std::vector<std::vector<double>> x;
+        for (size_t i = 0; i < bbv.bbvs.size(); ++i)
+            x.push_back(project(bbv.bbvs[i], bbv.insts[i]));
+
+        std::vector<std::vector<double>> centers;
+        if (fixed_k)
+            k = kmeans(x, std::min<size_t>(fixed_k, x.size()), seed, cluster, centers);
+        else
+            choose_k(x, max_k, seed, centers);
+
+        points.clear();
+        for (unsigned c = 0; c < k; ++c)
+        {
+            Point p;
+            double best = INFINITY;
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                if (cluster[i] != c)
+                    continue;
+                p.weight += bbv.insts[i];
+                // Prefer full-length intervals; the trailing one is short.
+                double d = dist2(x[i], centers[c]) + (bbv.insts[i] < interval ? 1e9 : 0.0);
+                if (d < best)
+                {
+                    best = d;
+                    p.interval = uint32_t(i);
+                }
+            }
+            if (p.weight == 0)
+                continue;
+            p.length = bbv.insts[p.interval];
+            p.start = uint64_t(p.interval) * interval;
+            p.start_cycle = bbv.start_cycles[p.interval];
+            points.push_back(p);
+        }
+        std::sort(points.begin(), points.end(), [](const Point &a, const Point &b)
+                  { return a.start < b.start; });
+    }
+
+    // Step 4: one fast-forward pass over a freshly reset core.
+    std::vector<Checkpoint> checkpoints(Emu16 &emu) const
+    {
+        std::vector<Checkpoint> out;
+        for (const Point &p : points)
+        {
+            if (emu.cycles < p.start_cycle)
+                emu.run_for(p.start_cycle - emu.cycles); // stops on exactly that boundary
+            while (!emu.halted && emu.retired < p.start)
+                emu.step();
+            Checkpoint c;
+            c.point = p;
+            c.snap = emu.snapshot();
+            out.push_back(std::move(c));
+        }
+        return out;
+    }
+
+    // Step 5: estimated total cycles of the whole program under `model`.
+    static uint64_t estimate(const std::vector<Checkpoint> &cps, const TimingModel &model, Emu16 &emu)
+    {
+        double total = 0;
+        for (const Checkpoint &c : cps)
+        {
+            emu.restore(c.snap);
+            uint64_t cycles = model.run(emu, c.point.length);
+            total += double(c.point.weight) * double(cycles) / double(c.point.length);
+        }
+        return uint64_t(total + 0.5);
+    }
+
+    // Checkpoint files: "E16CKPT1", the point, retired, registers, PC, flags,
+    // cycles, then the 64K RAM words; all little-endian.
+    static bool save(const std::string &path, const Checkpoint &c)
+    {
+        std::ofstream f(path, std::ios::binary);
+        if (!f)
+            return false;
+        f.write("E16CKPT1", 8);
+        put(f, c.point.interval, 4);
+        put(f, c.point.start, 8);
+        put(f, c.point.start_cycle, 8);
+        put(f, c.point.length, 8);
+        put(f, c.point.weight, 8);
+        put(f, c.snap.retired, 8);
+        for (uint16_t r : c.snap.R)
+            put(f, r, 2);
+        put(f, c.snap.PC, 2);
+        put(f, uint64_t(c.snap.F.Z | c.snap.F.N << 1 | c.snap.F.C << 2 | c.snap.F.V << 3 | c.snap.halted << 4), 1);
+        put(f, c.snap.cycles, 8);
+        for (uint16_t w : c.snap.mem)
+            put(f, w, 2);
+        return bool(f);
+    }
+    static bool load(const std::string &path, Checkpoint &c)
+    {
+        std::ifstream f(path, std::ios::binary);
+        char magic[8];
+        if (!f.read(magic, 8) || std::string(magic, 8) != "E16CKPT1")
+            return false;
+        c.point.interval = uint32_t(get(f, 4));
+        c.point.start = get(f, 8);
+        c.point.start_cycle = get(f, 8);
+        c.point.length = get(f, 8);
+        c.point.weight = get(f, 8);
+        c.snap.retired = get(f, 8);
+        for (uint16_t &r : c.snap.R)
+            r = uint16_t(get(f, 2));
+        c.snap.PC = uint16_t(get(f, 2));
+        uint64_t bits = get(f, 1);
+        c.snap.F.Z = bits & 1;
+        c.snap.F.N = bits & 2;
+        c.snap.F.C = bits & 4;
+        c.snap.F.V = bits & 8;
+        c.snap.halted = bits & 16;
+        c.snap.cycles = get(f, 8);
+        c.snap.mem.assign(65536, 0);
+        for (uint16_t &w : c.snap.mem)
+            w = uint16_t(get(f, 2));
+        return bool(f) && c.point.length > 0;
+    }
+
+private:
+    static void put(std::ofstream &f, uint64_t v, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+            f.put(char((v >> (8 * i)) & 0xFF));
+    }
+    static uint64_t get(std::ifstream &f, int bytes)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i)
+            v |= uint64_t(uint8_t(f.get())) << (8 * i);
+        return v;
+    }
+
+    // Fixed pseudo-random projection coefficient in [-1, 1) per (block, dim)
+    static double coeff(uint16_t block, unsigned dim)
+    {
+        uint64_t h = (uint64_t(block) << 8 | dim) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 32;
+        return double(h & 0xFFFFFF) / double(0x800000) - 1.0;
+    }
+
+    static std::vector<double> project(const BbvProfiler::Vector &v, uint64_t n)
+    {
+        std::vector<double> p(DIMS, 0.0);
+        for (const auto &kv : v)
+            for (unsigned d = 0; d < DIMS; ++d)
+                p[d] += double(kv.second) / double(n) * coeff(kv.first, d);
+        return p;
+    }
+
+    static double dist2(const std::vector<double> &a, const std::vector<double> &b)
+    {
+        double s = 0;
+        for (size_t d = 0; d < a.size(); ++d)
+            s += (a[d] - b[d]) * (a[d] - b[d]);
+        return s;
+    }
+
+    // k-means++ seeding and Lloyd iterations, best of 5 seeds. Returns the
+    // number of clusters actually used; fills assignment and centers.
+    static unsigned kmeans(const std::vector<std::vector<double>> &x, size_t k, uint64_t seed,
+                           std::vector<uint32_t> &assign, std::vector<std::vector<double>> &centers)
+    {
+        double best_sse = INFINITY;
+        for (unsigned trial = 0; trial < 5; ++trial)
+        {
+            uint64_t s = (seed + trial) * 0x9E3779B97F4A7C15ull + 1;
+            auto uniform = [&s]()
+            {
+                s ^= s >> 12;
+                s ^= s << 25;
+                s ^= s >> 27;
+                return double((s * 2685821657736338717ull) >> 11) / double(1ull << 53);
+            };
+            std::vector<std::vector<double>> c{x[size_t(uniform() * double(x.size()))]};
+            std::vector<double> d2(x.size());
+            while (c.size() < k)
+            {
+                double sum = 0;
+                for (size_t i = 0; i < x.size(); ++i)
+                {
+                    d2[i] = INFINITY;
+                    for (const auto &ci : c)
+                        d2[i] = std::min(d2[i], dist2(x[i], ci));
+                    sum += d2[i];
+                }
+                if (sum == 0)
+                    break; // fewer distinct points than k
+                double r = uniform() * sum;
+                size_t pick = 0;
+                while (pick + 1 < x.size() && (r -= d2[pick]) > 0)
+                    pick++;
+                c.push_back(x[pick]);
+            }
+            std::vector<uint32_t> a(x.size(), 0);
+            double sse = 0;
+            for (int iter = 0; iter < 100; ++iter)
+            {
+                bool moved = false;
+                sse = 0;
+                for (size_t i = 0; i < x.size(); ++i)
+                {
+                    uint32_t bi = 0;
+                    double bd = INFINITY;
+                    for (size_t j = 0; j < c.size(); ++j)
+                    {
+                        double d = dist2(x[i], c[j]);
+                        if (d < bd)
+                        {
+                            bd = d;
+                            bi = uint32_t(j);
+                        }
+                    }
+                    moved |= (a[i] != bi) || iter == 0;
+                    a[i] = bi;
+                    sse += bd;
+                }
+                if (!moved)
+                    break;
+                std::vector<std::vector<double>> sum(c.size(), std::vector<double>(DIMS, 0.0));
+                std::vector<size_t> n(c.size(), 0);
+                for (size_t i = 0; i < x.size(); ++i)
+                {
+                    n[a[i]]++;
+                    for (unsigned d = 0; d < DIMS; ++d)
+                        sum[a[i]][d] += x[i][d];
+                }
+                for (size_t j = 0; j < c.size(); ++j)
+                    if (n[j])
+                        for (unsigned d = 0; d < DIMS; ++d)
+                            c[j][d] = sum[j][d] / double(n[j]);
+            }
+            if (sse < best_sse)
+            {
+                best_sse = sse;
+                assign = a;
+                centers = c;
+            }
+        }
+        return unsigned(centers.size());
+    }
+
+    // Bayesian information criterion of a clustering under the spherical
+    // Gaussian model (Pelleg & Moore), as SimPoint uses to pick k.
+    static double bic(const std::vector<std::vector<double>> &x, const std::vector<uint32_t> &a,
+                      const std::vector<std::vector<double>> &c)
+    {
+        const double R = double(x.size()), M = DIMS, K = double(c.size());
+        std::vector<double> n(c.size(), 0.0);
+        double sse = 0;
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            n[a[i]] += 1;
+            sse += dist2(x[i], c[a[i]]);
+        }
+        double var = (R > K) ? sse / (M * (R - K)) : 0.0;
+        var = std::max(var, 1e-12);
+        double l = 0;
+        for (double ni : n)
+            if (ni > 0)
+                l += ni * std::log(ni) - ni * std::log(R) - ni * M / 2 * std::log(2 * 3.141592653589793 * var) - (ni - 1) * M / 2;
+        double params = (K - 1) + M * K + 1;
+        return l - params / 2 * std::log(R);
+    }
+
+    void choose_k(const std::vector<std::vector<double>> &x, unsigned max_k, uint64_t seed,
+                  std::vector<std::vector<double>> &centers)
+    {
+        struct Fit
+        {
+            unsigned k;
+            double bic;
+            std::vector<uint32_t> assign;
+            std::vector<std::vector<double>> centers;
+        };
+        std::vector<Fit> fits;
+        for (unsigned kk = 1; kk <= std::max(1u, max_k) && kk <= x.size(); ++kk)
+        {
+            Fit f;
+            f.k = kmeans(x, kk, seed, f.assign, f.centers);
+            if (f.k < kk)
+                break; // no more distinct behaviour to split
+            f.bic = bic(x, f.assign, f.centers);
+            fits.push_back(std::move(f));
+        }
+        double lo = INFINITY, hi = -INFINITY;
+        for (const Fit &f : fits)
+        {
+            lo = std::min(lo, f.bic);
+            hi = std::max(hi, f.bic);
+        }
+        for (Fit &f : fits)
+        {
+            if (f.bic >= lo + 0.9 * (hi - lo))
+            {
+                k = f.k;
+                cluster = std::move(f.assign);
+                centers = std::move(f.centers);
+                return;
+            }
+        }
+    }
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+/**
+ * Instruction mix statistics (Stats.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --stats out.json` attaches this probe to count, per retired
+ * instruction: its opcode, the opcode pair and triple it ends (in dynamic
+ * order, across jumps), and which registers it read and wrote. The numbers
+ * are meant for choosing superinstructions, ISA extensions and fast paths.
+ *
+ * Built only with the EMU16_STATS CMake option (on by default); without it
+ * this file is empty and emu16 rejects --stats.
+ */
+
+#ifdef EMU16_STATS
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "Emu16.cpp"
+
+struct OpcodeStats : Probe
+{
+    uint64_t total = 0;
+    uint64_t ops[32] = {0};
+    std::vector<uint64_t> pairs = std::vector<uint64_t>(32 * 32, 0);
+    std::vector<uint64_t> triples = std::vector<uint64_t>(32 * 32 * 32, 0);
+    uint64_t reg_reads[8] = {0}, reg_writes[8] = {0};
+
+    void on_retire(Emu16 &, uint16_t, uint16_t inst, uint64_t) override
+    {
+        const uint32_t op = (inst >> 11) & 0x1F;
+        ops[op]++;
+        if (total >= 1)
+            pairs[(prev1 << 5) | op]++;
+        if (total >= 2)
+            triples[(prev2 << 10) | (prev1 << 5) | op]++;
+        prev2 = prev1;
+        prev1 = op;
+        total++;
+        count_regs(op, (inst >> 8) & 7, (inst >> 5) & 7, (inst >> 2) & 7);
+    }
+
+    void write_json(std::ostream &o) const
+    {
+        o << "{\n  \"instructions\": " << total << ",\n  \"opcodes\": {";
+        bool first = true;
+        for (uint32_t op = 0; op < 32; ++op)
+        {
+            if (!ops[op])
+                continue;
+            o << (first ? "\n" : ",\n") << "    \"" << ISA::name(uint16_t(op)) << "\": " << ops[op];
+            first = false;
+        }
+        o << "\n  },\n  \"pairs\": ";
+        sequences(o, pairs, 2);
+        o << ",\n  \"triples\": ";
+        sequences(o, triples, 3);
+        o << ",\n  \"registers\": {";
+        for (int r = 0; r < 8; ++r)
+            o << (r ? ",\n" : "\n") << "    \"r" << r << "\": {\"reads\": " << reg_reads[r]
+              << ", \"writes\": " << reg_writes[r] << "}";
+        o << "\n  }\n}\n";
+    }
+
+private:
+    uint32_t prev1 = 0, prev2 = 0;
+
+    // Non-zero sequences, most frequent first: [{"seq": [...], "count": n}]
+    static void sequences(std::ostream &o, const std::vector<uint64_t> &counts, int len)
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> rows;
+        for (uint32_t k = 0; k < counts.size(); ++k)
+            if (counts[k])
+                rows.push_back({counts[k], k});
+        std::sort(rows.begin(), rows.end(), [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+                  { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+        o << "[";
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            o << (i ? ",\n" : "\n") << "    {\"seq\": [";
+            for (int k = len - 1; k >= 0; --k)
+                o << "\"" << ISA::name(uint16_t((rows[i].second >> (5 * k)) & 0x1F)) << "\"" << (k ? ", " : "");
+            o << "], \"count\": " << rows[i].first << "}";
+        }
+        o << (rows.empty() ? "]" : "\n  ]");
+    }
+
+    void count_regs(uint32_t op, uint32_t rd, uint32_t rs, uint32_t ra)
+    {
+        auto rd_ = [&](uint32_t r)
+        { reg_reads[r]++; };
+        auto wr_ = [&](uint32_t r)
+        { reg_writes[r]++; };
+        switch (op)
+        {
+        case ISA::MOV:
+            rd_(rs), wr_(rd);
+            break;
+        case ISA::ADD:
+        case ISA::SUB:
+        case ISA::AND:
+        case ISA::OR:
+        case ISA::XOR:
+        case ISA::SHL:
+        case ISA::SHR:
+        case ISA::MUL:
+            rd_(rd), rd_(rs), wr_(rd);
+            break;
+        case ISA::NOT_:
+        case ISA::ADDI:
+        case ISA::SUBI:
+            rd_(rd), wr_(rd);
+            break;
+        case ISA::CMP:
+        case ISA::ST_IND:
+            rd_(rd), rd_(rs);
+            break;
+        case ISA::PUSH:
+            rd_(rs), rd_(7), wr_(7);
+            break;
+        case ISA::POP:
+            rd_(7), wr_(rd), wr_(7);
+            break;
+        case ISA::LD_ABS:
+        case ISA::LDI:
+        case ISA::LEA:
+            wr_(rd);
+            break;
+        case ISA::ST_ABS:
+            rd_(rs);
+            break;
+        case ISA::CALL:
+        case ISA::RET:
+            rd_(7), wr_(7);
+            break;
+        case ISA::LD_IND:
+            rd_(rs), wr_(rd);
+            break;
+        case ISA::CAS:
+            rd_(rd), rd_(rs), rd_(ra), wr_(rd);
+            break;
+        case ISA::FADD:
+            rd_(rd), rd_(rs), wr_(rd);
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+#endif // EMU16_STATS
@@ -0,0 +1,186 @@
+#pragma once
+
+/**
+ * Guest symbol table (Symbols.cpp)
+ * -----------------------------------------------------------------------------
+ * Loads the label file written by `asm16 --sym` (one "ADDR name" line per
+ * label, ADDR in hex) and maps guest addresses back to "label+offset".
+ * The `asm16 --map` format (first line "# emu16-map") is detected and adds
+ * the source file, the source line of every emitted word and the sections.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Symbols
+{
+    std::vector<std::pair<uint16_t, std::string>> by_addr; // sorted by address
+    // Map files only
+    std::string file;
+    std::vector<uint32_t> lines;                          // per address, 0 = unknown
+    std::vector<std::pair<uint16_t, uint32_t>> sections;  // [start, end)
+
+    // False if the file can't be opened or holds a malformed address.
+    bool load(const std::string &path)
+    {
+        std::ifstream f(path);
+        if (!f)
+            return false;
+        std::string line;
+        bool is_map = false;
+        while (std::getline(f, line))
+        {
+            if (line.rfind("# emu16-map", 0) == 0)
+            {
+                is_map = true;
+                lines.assign(65536, 0);
+                continue;
+            }
+            std::istringstream in(line);
+            std::string kind, addr, name;
+            uint32_t a = 0, end = 0;
+            if (is_map)
+            {
+                if (!(in >> kind))
+                    continue;
+                if (kind == "file")
+                    std::getline(in >> std::ws, file);
+                else if (kind == "label" && (in >> addr >> name))
+                {
+                    if (!parse_hex(addr, a))
+                        return false;
+                    by_addr.push_back({uint16_t(a), name});
+                }
+                else if (kind == "section" && (in >> addr >> name))
+                {
+                    if (!parse_hex(addr, a) || !parse_hex(name, end))
+                        return false;
+                    sections.push_back({uint16_t(a), end});
+                }
+                else if (kind == "line")
+                {
+                    uint32_t count = 0, src_line = 0;
+                    if (!(in >> addr >> count >> src_line))
+                        continue;
+                    if (!parse_hex(addr, a))
+                        return false;
+                    for (uint32_t n = 0; n < count && a < 65536; ++n, ++a)
+                        lines[a] = src_line;
+                }
+                continue;
+            }
+            if (!(in >> addr >> name))
+                continue;
+            if (!parse_hex(addr, a))
+                return false;
+            by_addr.push_back({uint16_t(a), name});
+        }
+        std::stable_sort(by_addr.begin(), by_addr.end(),
+                         [](const std::pair<uint16_t, std::string> &a, const std::pair<uint16_t, std::string> &b)
+                         { return a.first < b.first; });
+        return true;
+    }
+
+    bool empty() const
+    {
+        return by_addr.empty();
+    }
+
+    // Hex address up to 0x10000 (a section end may be one past the top).
+    static bool parse_hex(const std::string &text, uint32_t &out)
+    {
+        char *end = nullptr;
+        errno = 0;
+        unsigned long v = std::strtoul(text.c_str(), &end, 16);
+        if (text.empty() || *end || errno == ERANGE || v > 0x10000)
+            return false;
+        out = uint32_t(v);
+        return true;
+    }
+
+    // Nearest label at or below addr; nullptr if there is none.
+    const std::pair<uint16_t, std::string> *lookup(uint16_t addr) const
+    {
+        auto it = std::upper_bound(by_addr.begin(), by_addr.end(), addr,
+                                   [](uint16_t a, const std::pair<uint16_t, std::string> &s)
+                                   { return a < s.first; });
+        if (it == by_addr.begin())
+            return nullptr;
+        --it;
+        // Several labels may share an address; report the first one.
+        while (it != by_addr.begin() && (it - 1)->first == it->first)
+            --it;
+        return &*it;
+    }
+
+    // Exact label at addr, or "" if none.
+    std::string name_at(uint16_t addr) const
+    {
+        const auto *s = lookup(addr);
+        return (s && s->first == addr) ? s->second : std::string();
+    }
+
+    // "label+0x3", "label", or "0x1234" when no label covers the address.
+    std::string format(uint16_t addr) const
+    {
+        std::ostringstream o;
+        const auto *s = lookup(addr);
+        if (!s)
+        {
+            o << "0x" << std::hex << std::uppercase << addr;
+            return o.str();
+        }
+        o << s->second;
+        if (addr != s->first)
+            o << "+0x" << std::hex << std::uppercase << (addr - s->first);
+        return o.str();
+    }
+
+    // "file.asm:42", or "" without line information for addr.
+    std::string source(uint16_t addr) const
+    {
+        if (lines.empty() || !lines[addr])
+            return std::string();
+        return file + ":" + std::to_string(lines[addr]);
+    }
+
+    // Just the label name (the "function" an address belongs to).
+    std::string owner(uint16_t addr) const
+    {
+        const auto *s = lookup(addr);
+        if (s)
+            return s->second;
+        std::ostringstream o;
+        o << "0x" << std::hex << std::uppercase << addr;
+        return o.str();
+    }
+};
+
+// Symbol names and source paths come from user files; every JSON writer
+// passes them through this before quoting.
+inline std::string json_escape(const std::string &s)
+{
+    std::string out;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+        if (uint8_t(c) < 0x20)
+        {
+            char u[8];
+            std::snprintf(u, sizeof(u), "\\u%04x", unsigned(c));
+            out += u;
+            continue;
+        }
+        out.push_back(c);
+    }
+    return out;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+ * Timeline export (Timeline.cpp)
+ * -----------------------------------------------------------------------------
+ * `emu16 --timeline out.json` attaches this probe and writes the Chrome
+ * trace-event format (chrome://tracing, Perfetto UI, speedscope):
+ *
+ *   • a B/E pair per guest function activation, matched CALL -> RET the same
+ *     way as the call-graph profiler (a RET closes every frame above the one
+ *     it returns through);
+ *   • an instant event per MMIO store (TX_CHAR, TX_STR, TX_INT, ...).
+ *
+ * Timestamps are guest cycles, written as the format's microseconds, so one
+ * "us" in the viewer is one cycle. Events are appended to an in-memory
+ * vector during the run and only formatted in write_json() afterwards.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Emu16.cpp"
+#include "Symbols.cpp"
+
+struct Timeline : Probe
+{
+    enum Kind : uint8_t
+    {
+        Begin,
+        End,
+        Device,
+    };
+    struct Event
+    {
+        uint64_t ts;
+        uint16_t addr;  // function (Begin/End) or MMIO address
+        uint16_t value; // MMIO value
+        Kind kind;
+    };
+
+    std::vector<Event> events;
+    uint16_t core = 0;
+
+    void on_flow(Emu16 &, Flow kind, uint16_t pc, uint16_t target, bool) override
+    {
+        call.note(kind, pc, target);
+    }
+
+    void on_store(Emu16 &cpu, uint16_t addr, uint16_t value) override
+    {
+        if (addr >= 0xFF00)
+            events.push_back({cpu.cycles, addr, value, Device});
+    }
+
+    void on_retire(Emu16 &cpu, uint16_t pc, uint16_t, uint64_t cycles_before) override
+    {
+        if (stack.empty())
+            push(pc, 0, cycles_before);
+        if (call.pending == Flow::Call)
+            push(call.func, call.ret, cpu.cycles);
+        else if (call.pending == Flow::Ret)
+        {
+            size_t keep = CallRet::unwind_to(stack.size(), 1, call.ret, [&](size_t i)
+                                             { return stack[i].second; });
+            while (stack.size() > std::max<size_t>(keep, 1))
+                pop(cpu.cycles);
+        }
+        call.pending = Flow::Jump;
+    }
+
+    // Close every open span at the final cycle count.
+    void finish(uint64_t now)
+    {
+        while (!stack.empty())
+            pop(now);
+    }
+
+    void write_json(std::ostream &o, const Symbols &sym) const
+    {
+        o << "{\"displayTimeUnit\": \"ns\", \"otherData\": {\"time_unit\": \"1 us = 1 guest cycle\"},\n"
+          << "\"traceEvents\": [\n"
+          << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"emu16\"}},\n"
+          << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << core
+          << ", \"args\": {\"name\": \"core " << core << "\"}}";
+        for (const Event &e : events)
+        {
+            o << ",\n{\"ts\": " << e.ts << ", \"pid\": 1, \"tid\": " << core << ", ";
+            if (e.kind == Device)
+            {
+                o << "\"ph\": \"i\", \"s\": \"t\", \"cat\": \"mmio\", \"name\": \"" << device_label(e.addr, e.value)
+                  << "\", \"args\": {\"addr\": \"" << Emu16::hex4(e.addr) << "\", \"value\": " << e.value << "}}";
+                continue;
+            }
+            o << "\"ph\": \"" << (e.kind == Begin ? 'B' : 'E') << "\", \"cat\": \"call\", \"name\": \""
+              << json_escape(sym.owner(e.addr)) << "\"}";
+        }
+        o << "\n]}\n";
+    }
+
+private:
+    std::vector<std::pair<uint16_t, uint16_t>> stack; // (function, return address)
+    CallRet call;
+
+    void push(uint16_t func, uint16_t ret, uint64_t now)
+    {
+        stack.push_back({func, ret});
+        events.push_back({now, func, 0, Begin});
+    }
+    void pop(uint64_t now)
+    {
+        events.push_back({now, stack.back().first, 0, End});
+        stack.pop_back();
+    }
+
+    static std::string device_label(uint16_t addr, uint16_t v)
+    {
+        switch (addr)
+        {
+        case 0xFF00:
+            return "TX_CHAR " + json_escape(std::string(1, char(v & 0xFF)));
+        case 0xFF10:
+            return "TX_STR " + Emu16::hex4(v);
+        case 0xFF12:
+            return "TX_INT " + std::to_string(v);
+        default:
+            return "MMIO " + Emu16::hex4(addr);
+        }
+    }
+};
@@ -4,23 +4,164 @@
 #include <cstdint>
 #include <iomanip>
 #include <sstream>
+#include <cstdlib>
+#include <memory>
+#include "BinaryTrace.cpp"
+#include "BranchPredictor.cpp"
+#include "CacheSim.cpp"
+#include "CallGraph.cpp"
 #include "Emu16.cpp"
+#include "Heatmap.cpp"
+#include "Job.cpp"
+#include "Loader.cpp"
+#include "Metrics.cpp"
+#include "MultiCore.cpp"
+#include "Pipeline.cpp"
+#include "Profiler.cpp"
+#include "Regions.cpp"
+#include "ResultCache.cpp"
+#include "RunStats.cpp"
+#include "Sampler.cpp"
+#include "Server.cpp"
+#include "Stats.cpp"
+#include "Symbols.cpp"
+#include "Timeline.cpp"
 
 static void usage(const char* argv0){
-    std::cerr << "Usage: " << argv0 << " [--trace] [--memdump <file>] <program.bin>\n";
+    std::cerr << "Usage: " << argv0 << " [--trace] [--memdump <file>] [--patch <addr>=<w0>[,<w1>...]] [--max-cycles <n>]\n"
+              << "       [--cache-dir <dir> [--cache-max-entries <n>]] [--cores <n> [--threads | --quantum <cycles>]]\n"
+              << "       [--sym <file.sym> | --map <file.map>] [--profile <out.json>] [--callgraph <out.folded>] [--timeline <out.json>] [--flight]\n"
+              << "       [--sample <out.folded> [--sample-hz <n>]] [--stats <out.json>] [--heatmap <out.json>] [--stats-json <out.json>]\n"
+              << "       [--metrics-shm <name>] [--regions <out.json>] [--pipeline <out.json>]\n"
+              << "       [--icache <spec>] [--dcache <spec>] [--miss-penalty <cycles>] [--cache-stats <out.json>]\n"
+              << "       [--bpred <predictor>[,<predictor>...] [--ras <depth>] [--bpred-stats <out.json>]]\n"
+              << "       [--trace-bin <out.e16t> [--trace-pc <lo>:<hi>] [--trace-cycles <from>:<to>]] <program.bin>\n"
+              << "       " << argv0 << " --serve <socket> [--pool <n>] [--cache-dir <dir> [--cache-max-entries <n>]]\n";
+}
+
+// "0x0100=1,2,0xFFFF" -> (0x0100, {1, 2, 0xFFFF})
+static bool parse_patch(const std::string& s, std::pair<uint16_t, std::vector<uint16_t>>& p){
+    size_t eq = s.find('=');
+    if(eq == std::string::npos) return false;
+    char* end = nullptr;
+    p.first = uint16_t(std::strtoul(s.c_str(), &end, 0));
+    if(end != s.c_str() + eq) return false;
+    p.second.clear();
+    std::stringstream ss(s.substr(eq + 1));
+    std::string w;
+    while(std::getline(ss, w, ',')){
+        p.second.push_back(uint16_t(std::strtoul(w.c_str(), &end, 0)));
+        if(w.empty() || *end) return false;
+    }
+    return !p.second.empty();
 }
 
 int main(int argc, char** argv){
     bool trace = false;
+    bool flight = false;
     std::string path;
     std::string memdump;
+    unsigned cores = 1;
+    bool threads = false;
+    uint64_t quantum = 1000;
+    std::string serve;
+    unsigned pool = 4;
+    std::string cache_dir;
+    uint64_t cache_max = ResultCache::DEFAULT_MAX_ENTRIES;
+    Job job;
+    job.cycle_limit = 0;
+    std::string sym_path, profile_path, callgraph_path, timeline_path, trace_bin, sample_path, stats_path, heatmap_path, run_stats_path, metrics_name, regions_path, pipeline_path, cache_stats_path, bpred_list, bpred_stats_path;
+    unsigned sample_hz = Sampler::DEFAULT_HZ;
+    TraceFilter trace_filter;
+    CacheConfig icache_cfg, dcache_cfg;
+    bool icache_on = false, dcache_on = false;
+    uint32_t miss_penalty = 0;
+    unsigned ras_depth = 8;
 
     for(int i=1;i<argc;i++){
         std::string a = argv[i];
         if(a == "--trace") {
             trace = true;
+        } else if(a == "--flight") {
+            flight = true;
         } else if(a == "--memdump" && i+1 < argc) {
             memdump = argv[++i];
+        } else if(a == "--cores" && i+1 < argc) {
+            cores = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        } else if(a == "--threads") {
+            threads = true;
+        } else if(a == "--quantum" && i+1 < argc) {
+            quantum = std::strtoull(argv[++i], nullptr, 0);
+        } else if(a == "--serve" && i+1 < argc) {
+            serve = argv[++i];
+        } else if(a == "--pool" && i+1 < argc) {
+            pool = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        } else if(a == "--cache-dir" && i+1 < argc) {
+            cache_dir = argv[++i];
+        } else if(a == "--cache-max-entries" && i+1 < argc) {
+            cache_max = std::strtoull(argv[++i], nullptr, 0);
+        } else if(a == "--max-cycles" && i+1 < argc) {
+            job.cycle_limit = std::strtoull(argv[++i], nullptr, 0);
+        } else if((a == "--sym" || a == "--map") && i+1 < argc) {
+            sym_path = argv[++i];
+        } else if(a == "--profile" && i+1 < argc) {
+            profile_path = argv[++i];
+        } else if(a == "--callgraph" && i+1 < argc) {
+            callgraph_path = argv[++i];
+        } else if(a == "--sample" && i+1 < argc) {
+            sample_path = argv[++i];
+        } else if(a == "--sample-hz" && i+1 < argc) {
+            sample_hz = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        } else if(a == "--stats" && i+1 < argc) {
+#ifdef EMU16_STATS
+            stats_path = argv[++i];
+#else
+            std::cerr << "--stats: this emu16 was built without EMU16_STATS\n";
+            return 1;
+#endif
+        } else if(a == "--regions" && i+1 < argc) {
+            regions_path = argv[++i];
+        } else if(a == "--metrics-shm" && i+1 < argc) {
+            metrics_name = argv[++i];
+        } else if(a == "--stats-json" && i+1 < argc) {
+            run_stats_path = argv[++i];
+        } else if(a == "--pipeline" && i+1 < argc) {
+            pipeline_path = argv[++i];
+        } else if((a == "--icache" || a == "--dcache") && i+1 < argc) {
+            std::string err;
+            if(!(a == "--icache" ? icache_cfg : dcache_cfg).parse(argv[++i], err)){
+                std::cerr << a << ": " << err << "\n";
+                return 1;
+            }
+            (a == "--icache" ? icache_on : dcache_on) = true;
+        } else if(a == "--miss-penalty" && i+1 < argc) {
+            miss_penalty = uint32_t(std::strtoul(argv[++i], nullptr, 0));
+        } else if(a == "--cache-stats" && i+1 < argc) {
+            cache_stats_path = argv[++i];
+        } else if(a == "--bpred" && i+1 < argc) {
+            bpred_list = argv[++i];
+        } else if(a == "--ras" && i+1 < argc) {
+            ras_depth = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        } else if(a == "--bpred-stats" && i+1 < argc) {
+            bpred_stats_path = argv[++i];
+        } else if(a == "--heatmap" && i+1 < argc) {
+            heatmap_path = argv[++i];
+        } else if(a == "--timeline" && i+1 < argc) {
+            timeline_path = argv[++i];
+        } else if(a == "--trace-bin" && i+1 < argc) {
+            trace_bin = argv[++i];
+        } else if((a == "--trace-pc" || a == "--trace-cycles") && i+1 < argc) {
+            uint64_t lo = 0, hi = (a == "--trace-pc") ? 0xFFFF : UINT64_MAX;
+            if(!parse_trace_range(argv[++i], lo, hi) || (a == "--trace-pc" && hi > 0xFFFF)){
+                std::cerr << "Bad " << a << " " << argv[i] << "\n";
+                return 1;
+            }
+            if(a == "--trace-pc"){ trace_filter.pc_lo = uint16_t(lo); trace_filter.pc_hi = uint16_t(hi); }
+            else { trace_filter.cycle_lo = lo; trace_filter.cycle_hi = hi; }
+        } else if(a == "--patch" && i+1 < argc) {
+            std::pair<uint16_t, std::vector<uint16_t>> p;
+            if(!parse_patch(argv[++i], p)){ std::cerr << "Bad --patch " << argv[i] << "\n"; return 1; }
+            job.patches.push_back(p);
         } else if(a.size() && a[0] == '-') {
             usage(argv[0]);
             return 1;
@@ -28,24 +169,237 @@ int main(int argc, char** argv){
             path = a;
         }
     }
+    std::unique_ptr<ResultCache> cache;
+    if(!cache_dir.empty()) cache.reset(new ResultCache(cache_dir, cache_max));
+    if(!serve.empty()) return run_server(serve, pool, cache.get());
     if(path.empty()){ usage(argv[0]); return 1; }
+    if(cores < 1 || cores > MultiCore::MAX_CORES || quantum == 0){
+        std::cerr << "--cores must be 1.." << MultiCore::MAX_CORES << " and --quantum non-zero\n";
+        return 1;
+    }
+    const bool profiling = !profile_path.empty() || !callgraph_path.empty() || !timeline_path.empty()
+                        || !trace_bin.empty() || !sample_path.empty() || !stats_path.empty() || !heatmap_path.empty()
+                        || !pipeline_path.empty() || icache_on || dcache_on
+                        || !bpred_list.empty();
+    if(cores > 1 && (cache || job.cycle_limit || profiling || !metrics_name.empty())){
+        std::cerr << "--cache-dir, --max-cycles, --metrics-shm and the profiling/trace options apply to single-core runs only\n";
+        return 1;
+    }
+    // Traced, profiled and instrumented runs exist for their side output, which
+    // a cache hit would not reproduce, so never cache them.
+    if(trace || profiling || flight || !regions_path.empty() || !metrics_name.empty() || !run_stats_path.empty())
+        cache.reset();
+    job.image = path;
+
+    Symbols sym;
+    if(!sym_path.empty() && !sym.load(sym_path)){ std::cerr << "Failed to read symbols from " << sym_path << "\n"; return 1; }
+    std::unique_ptr<Profiler> profiler;
+    if(!profile_path.empty()) profiler.reset(new Profiler());
+    std::unique_ptr<CallGraph> callgraph;
+    if(!callgraph_path.empty()) callgraph.reset(new CallGraph());
+    std::unique_ptr<Timeline> timeline;
+    if(!timeline_path.empty()) timeline.reset(new Timeline());
+    std::unique_ptr<Heatmap> heatmap;
+    if(!heatmap_path.empty()) heatmap.reset(new Heatmap());
+    std::unique_ptr<Pipeline> pipeline;
+    if(!pipeline_path.empty()) pipeline.reset(new Pipeline());
+    if(!cache_stats_path.empty() && !icache_on && !dcache_on){
+        std::cerr << "--cache-stats needs --icache and/or --dcache\n";
+        return 1;
+    }
+    std::unique_ptr<BranchSim> bpred;
+    if(!bpred_list.empty()){
+        bpred.reset(new BranchSim(ras_depth));
+        std::stringstream ss(bpred_list);
+        std::string spec, err;
+        while(std::getline(ss, spec, ',')){
+            std::unique_ptr<BranchPredictor> p = BranchPredictor::create(spec, err);
+            if(!p){ std::cerr << "--bpred: " << err << "\n"; return 1; }
+            if(pipeline && bpred->entries.empty()) pipeline->predict_with(BranchPredictor::create(spec, err), ras_depth);
+            bpred->add(std::move(p));
+        }
+    } else if(!bpred_stats_path.empty()){
+        std::cerr << "--bpred-stats needs --bpred\n";
+        return 1;
+    }
+    std::unique_ptr<CacheSim> caches;
+    if(icache_on || dcache_on)
+        caches.reset(new CacheSim(icache_on ? &icache_cfg : nullptr, dcache_on ? &dcache_cfg : nullptr, miss_penalty));
+#ifdef EMU16_STATS
+    std::unique_ptr<OpcodeStats> stats;
+    if(!stats_path.empty()) stats.reset(new OpcodeStats());
+#endif
+    std::unique_ptr<Sampler> sampler;
+    if(!sample_path.empty()) sampler.reset(new Sampler());
+    std::unique_ptr<BinaryTrace> bintrace;
+    if(!trace_bin.empty()){
+        bintrace.reset(new BinaryTrace());
+        bintrace->filter = trace_filter;
+    }
 
     // load binary (little-endian bytes making 16-bit words)
-    std::ifstream f(path, std::ios::binary);
-    if(!f){ std::cerr << "Failed to open " << path << "\n"; return 1; }
-    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(f)), {});
     std::vector<uint16_t> rom;
-    for(size_t i=0;i<bytes.size();){
-        uint16_t w = bytes[i];
-        if(i+1 < bytes.size()) w |= (uint16_t(bytes[i+1])<<8);
-        rom.push_back(w);
-        i += 2;
-    }
+    if(!load_image(path, rom)){ std::cerr << "Failed to open " << path << "\n"; return 1; }
 
     Emu16 emu(trace);
-    emu.load(rom, 0x0000);
-    emu.reset();
-    emu.run();
+    RunStats run_stats;
+    std::unique_ptr<MultiCore> mc;
+    Memory* final_mem = &emu.mem;
+    JobResult res;
+    if(cores > 1){
+        mc.reset(new MultiCore(cores, trace));
+        mc->load(rom, 0x0000);
+        mc->reset();
+        apply_patches(*mc->cores.front(), job);
+        if(!sym.empty())
+            for(auto& c : mc->cores) c->flight_names = [&sym](uint16_t a){ return sym.format(a); };
+        run_stats.start();
+        if(threads) mc->run_threaded();
+        else mc->run_quantum(quantum);
+        run_stats.stop();
+        final_mem = &mc->mem;
+        if(flight)
+            for(auto& c : mc->cores) c->dump_flight(std::cerr);
+    } else {
+        std::string key;
+        if(cache) key = ResultCache::key(image_digest(rom), job);
+        if(cache && cache->lookup(key, res)){
+            std::cout << res.output << std::flush;
+            unpack_memory(res, emu.mem.mem);
+        } else {
+            emu.load(rom, 0x0000);
+            emu.reset();
+            apply_patches(emu, job);
+            if(!sym.empty()) emu.flight_names = [&sym](uint16_t a){ return sym.format(a); };
+            if(profiler) emu.attach(profiler.get());
+            if(callgraph) emu.attach(callgraph.get());
+            if(timeline) emu.attach(timeline.get());
+            if(heatmap) emu.attach(heatmap.get());
+            if(pipeline) emu.attach(pipeline.get());
+            if(caches) emu.attach(caches.get());
+            if(bpred) emu.attach(bpred.get());
+#ifdef EMU16_STATS
+            if(stats) emu.attach(stats.get());
+#endif
+            if(bintrace){
+                if(!bintrace->open(trace_bin, emu)){ std::cerr << "Failed to open trace file: " << trace_bin << "\n"; return 1; }
+                emu.attach(bintrace.get());
+            }
+            std::ostringstream captured;
+            TeeBuf tee(std::cout.rdbuf(), captured.rdbuf());
+            std::ostream tee_out(&tee);
+            if(cache) emu.mem.io.out = &tee_out;
+            if(sampler){
+                std::string err;
+                if(!sampler->start(emu, sample_hz, err)){ std::cerr << "--sample: " << err << "\n"; return 1; }
+            }
+            MetricsPublisher metrics;
+            if(!metrics_name.empty()){
+                std::string err;
+                if(!metrics.open(metrics_name, path, err)){ std::cerr << "--metrics-shm: " << err << "\n"; return 1; }
+            }
+            run_stats.start();
+            if(!metrics_name.empty()) metrics.run(emu, job.cycle_limit);
+            else run_job_cycles(emu, job.cycle_limit);
+            run_stats.stop();
+            if(sampler) sampler->stop();
+            collect_result(emu, job, captured.str(), res, cache != nullptr);
+            if(cache) cache->store(key, res);
+            // Faults print the recorder from the core; budget stops and --flight do it here.
+            if(res.status == "budget" || (flight && res.status != "fault")) emu.dump_flight(std::cerr);
+        }
+        if(res.status == "budget")
+            std::cerr << "emu16: cycle limit reached after " << res.cycles << " cycles at PC=" << Emu16::hex4(res.PC) << "\n";
+    }
+
+    if(profiler){
+        std::ofstream pf(profile_path);
+        if(!pf){ std::cerr << "Failed to open profile file: " << profile_path << "\n"; return 1; }
+        profiler->write_json(pf, sym);
+        profiler->report(std::cerr, sym);
+    }
+    if(bintrace){
+        uint64_t bytes = bintrace->close();
+        std::cerr << "emu16: traced " << bintrace->recorded << " instructions to " << trace_bin << " ("
+                  << bytes << " bytes, " << std::fixed << std::setprecision(2)
+                  << (bintrace->recorded ? double(bytes) / double(bintrace->recorded) : 0.0) << " bytes/instruction, "
+                  << bintrace->stalls << " ring stalls)\n";
+    }
+    if(sampler){
+        std::ofstream sf(sample_path);
+        if(!sf){ std::cerr << "Failed to open sample file: " << sample_path << "\n"; return 1; }
+        sampler->write_folded(sf, sym);
+        sampler->report(std::cerr, sym);
+    }
+    if(timeline){
+        timeline->finish(emu.cycles);
+        std::ofstream tf(timeline_path);
+        if(!tf){ std::cerr << "Failed to open timeline file: " << timeline_path << "\n"; return 1; }
+        timeline->write_json(tf, sym);
+    }
+    if(callgraph){
+        callgraph->finish(emu.cycles);
+        std::ofstream cf(callgraph_path);
+        if(!cf){ std::cerr << "Failed to open callgraph file: " << callgraph_path << "\n"; return 1; }
+        callgraph->write_folded(cf, sym);
+        callgraph->report(std::cerr, sym);
+    }
+    std::vector<const Emu16*> ran;
+    std::string status = res.status;
+    if(mc){
+        status = "halted";
+        for(auto& c : mc->cores){
+            ran.push_back(c.get());
+            if(c->faulted) status = "fault";
+        }
+    } else ran.push_back(&emu);
+    for(const Emu16* c : ran)
+        if(RegionReport::used(*c)) RegionReport::report(std::cerr, *c, sym);
+    if(!regions_path.empty()){
+        std::ofstream gf(regions_path);
+        if(!gf){ std::cerr << "Failed to open regions file: " << regions_path << "\n"; return 1; }
+        RegionReport::write_json(gf, ran, sym);
+    }
+    if(!run_stats_path.empty()){
+        std::ofstream rf(run_stats_path);
+        if(!rf){ std::cerr << "Failed to open stats file: " << run_stats_path << "\n"; return 1; }
+        run_stats.write_json(rf, ran, final_mem->io, status);
+    }
+    if(heatmap){
+        std::ofstream hf(heatmap_path);
+        if(!hf){ std::cerr << "Failed to open heatmap file: " << heatmap_path << "\n"; return 1; }
+        heatmap->write_json(hf, sym);
+        heatmap->report(std::cerr, sym);
+    }
+    if(pipeline){
+        std::ofstream pf(pipeline_path);
+        if(!pf){ std::cerr << "Failed to open pipeline file: " << pipeline_path << "\n"; return 1; }
+        pipeline->write_json(pf, sym);
+        pipeline->report(std::cerr, sym);
+    }
+    if(caches){
+        if(!cache_stats_path.empty()){
+            std::ofstream cf(cache_stats_path);
+            if(!cf){ std::cerr << "Failed to open cache stats file: " << cache_stats_path << "\n"; return 1; }
+            caches->write_json(cf, sym);
+        }
+        caches->report(std::cerr, sym);
+    }
+    if(bpred){
+        if(!bpred_stats_path.empty()){
+            std::ofstream bf(bpred_stats_path);
+            if(!bf){ std::cerr << "Failed to open branch stats file: " << bpred_stats_path << "\n"; return 1; }
+            bpred->write_json(bf, sym);
+        }
+        bpred->report(std::cerr, sym);
+    }
+#ifdef EMU16_STATS
+    if(stats){
+        std::ofstream sf(stats_path);
+        if(!sf){ std::cerr << "Failed to open stats file: " << stats_path << "\n"; return 1; }
+        stats->write_json(sf);
+    }
+#endif
 
     // --- NEW: full-memory dump after program finishes ---
     if(!memdump.empty()){
@@ -58,8 +412,8 @@ int main(int argc, char** argv){
         md.setf(std::ios::hex, std::ios::basefield);
         md.setf(std::ios::uppercase);
         md.fill('0');
-        for(uint32_t addr = 0; addr < emu.mem.mem.size(); ++addr){
-            md << std::setw(4) << addr << " " << std::setw(4) << (emu.mem.mem[addr] & 0xFFFF) << "\n";
+        for(uint32_t addr = 0; addr < final_mem->mem.size(); ++addr){
+            md << std::setw(4) << addr << " " << std::setw(4) << (final_mem->mem[addr] & 0xFFFF) << "\n";
         }
     }
     return 0;
@@ -0,0 +1,256 @@
+/**
+ * emu16-fuzz — in-process, coverage-guided fuzzer for guest routines
+ * -----------------------------------------------------------------------------
+ * Loads a program once, snapshots the reset state and then, per iteration:
+ *   1) restores the snapshot (only the 256-word pages the guest dirtied),
+ *   2) writes a mutated input into the configured guest memory regions,
+ *   3) runs until HALT, an unknown opcode (crash) or the cycle budget (hang),
+ *   4) keeps the input if it lit up new edges in the AFL-style coverage map.
+ *
+ * Inputs are the concatenation of all --region payloads, one 16-bit word per
+ * guest address. Queue/crash/hang files use the same little-endian layout as
+ * asm16 .bin output so they can be inspected with the usual tools.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include "../emulator/Emu16.cpp"
+#include "../emulator/Loader.cpp"
+
+namespace fs = std::filesystem;
+
+static void usage(const char* argv0){
+    std::cerr << "Usage: " << argv0 << " <program.bin> --region <addr>:<len> [--region ...]\n"
+              << "       [--entry <addr>] [--budget <cycles>] [--iters <n>] [--time <sec>]\n"
+              << "       [--seed <n>] [--in <dir>] [--out <dir>]\n";
+}
+
+struct Region { uint16_t addr; uint16_t len; };
+
+// xorshift64* — cheap, good enough to drive mutations
+struct Rng {
+    uint64_t s;
+    explicit Rng(uint64_t seed) : s(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+    uint64_t next(){ s ^= s >> 12; s ^= s << 25; s ^= s >> 27; return s * 2685821657736338717ull; }
+    uint32_t below(uint32_t n){ return uint32_t(next() % n); }
+};
+
+// AFL hit-count buckets: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+
+static uint8_t count_class[256];
+static void init_count_class(){
+    for(int i=0;i<256;i++){
+        uint8_t c = 0;
+        if(i == 0) c = 0;
+        else if(i == 1) c = 1;
+        else if(i == 2) c = 2;
+        else if(i == 3) c = 4;
+        else if(i < 8) c = 8;
+        else if(i < 16) c = 16;
+        else if(i < 32) c = 32;
+        else if(i < 128) c = 64;
+        else c = 128;
+        count_class[i] = c;
+    }
+}
+
+// Classify the trace map in place and merge into virgin; true if any new bit.
+static bool has_new_bits(uint8_t* trace, uint8_t* virgin, size_t n){
+    bool found = false;
+    for(size_t w = 0; w < n/8; ++w){
+        uint64_t word;
+        std::memcpy(&word, trace + w*8, sizeof word); // skip 8 empty slots at once
+        if(!word) continue;
+        for(size_t i = w*8; i < w*8 + 8; ++i){
+            if(!trace[i]) continue;
+            uint8_t c = count_class[trace[i]];
+            trace[i] = c;
+            if(c & virgin[i]){ virgin[i] &= uint8_t(~c); found = true; }
+        }
+    }
+    return found;
+}
+
+static size_t count_edges(const uint8_t* virgin, size_t n){
+    size_t e = 0;
+    for(size_t i=0;i<n;i++) if(virgin[i] != 0xFF) e++;
+    return e;
+}
+
+static void save_words(const fs::path& p, const std::vector<uint16_t>& w){
+    std::ofstream f(p, std::ios::binary);
+    for(uint16_t v : w){ f.put(char(v & 0xFF)); f.put(char(v >> 8)); }
+}
+
+static const uint16_t interesting[] = { 0, 1, 2, 0x7F, 0x80, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFFFE, 0xFFFF };
+
+static void mutate(std::vector<uint16_t>& in, const std::vector<std::vector<uint16_t>>& queue, Rng& rng){
+    if(in.empty()) return;
+    uint32_t n = uint32_t(in.size());
+    uint32_t ops = 1u << (1 + rng.below(3));
+    for(uint32_t k=0;k<ops;k++){
+        uint32_t at = rng.below(n);
+        switch(rng.below(7)){
+        case 0: in[at] ^= uint16_t(1u << rng.below(16)); break;
+        case 1: in[at] = interesting[rng.below(sizeof(interesting)/sizeof(interesting[0]))]; break;
+        case 2: { uint16_t d = uint16_t(1 + rng.below(35)); in[at] = rng.below(2) ? uint16_t(in[at] + d) : uint16_t(in[at] - d); } break;
+        case 3: in[at] = uint16_t(rng.next()); break;
+        case 4: in[at] = uint16_t(rng.below(256)); break;
+        case 5: in[at] = in[rng.below(n)]; break;
+        case 6: {
+            const auto& other = queue[rng.below(uint32_t(queue.size()))];
+            uint32_t from = rng.below(n), len = 1 + rng.below(n - from);
+            std::memcpy(&in[from], &other[from], len * sizeof(uint16_t));
+        } break;
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    std::string path, out_dir = "fuzz-out", in_dir;
+    std::vector<Region> regions;
+    uint16_t entry = 0;
+    uint64_t budget = 100000, iters = 0, seed = 1;
+    double time_limit = 0;
+
+    try {
+        for(int i=1;i<argc;i++){
+            std::string a = argv[i];
+            if(a == "--region" && i+1 < argc){
+                std::string r = argv[++i];
+                size_t c = r.find(':');
+                if(c == std::string::npos){ usage(argv[0]); return 1; }
+                Region reg{ uint16_t(std::stoul(r.substr(0, c), nullptr, 0)), uint16_t(std::stoul(r.substr(c+1), nullptr, 0)) };
+                if(reg.len == 0 || uint32_t(reg.addr) + reg.len > 0xFF00){
+                    std::cerr << "Region " << r << " must be non-empty and below the MMIO window\n";
+                    return 1;
+                }
+                regions.push_back(reg);
+            }
+            else if(a == "--entry" && i+1 < argc) entry = uint16_t(std::stoul(argv[++i], nullptr, 0));
+            else if(a == "--budget" && i+1 < argc) budget = std::stoull(argv[++i], nullptr, 0);
+            else if(a == "--iters" && i+1 < argc) iters = std::stoull(argv[++i], nullptr, 0);
+            else if(a == "--time" && i+1 < argc) time_limit = std::stod(argv[++i]);
+            else if(a == "--seed" && i+1 < argc) seed = std::stoull(argv[++i], nullptr, 0);
+            else if(a == "--in" && i+1 < argc) in_dir = argv[++i];
+            else if(a == "--out" && i+1 < argc) out_dir = argv[++i];
+            else if(a.size() && a[0] == '-'){ usage(argv[0]); return 1; }
+            else path = a;
+        }
+    } catch(const std::exception&){
+        usage(argv[0]);
+        return 1;
+    }
+    if(path.empty() || regions.empty()){ usage(argv[0]); return 1; }
+
+    std::vector<uint16_t> rom;
+    if(!load_image(path, rom)){ std::cerr << "Failed to open " << path << "\n"; return 1; }
+
+    Emu16 emu(false);
+    emu.mem.io.out = nullptr;
+    emu.report_faults = false;
+    emu.load(rom, 0x0000);
+    emu.reset();
+    emu.PC = entry;
+    emu.mem.track_dirty = true;
+    const Snapshot base = emu.snapshot();
+
+    static uint8_t trace_bits[Emu16::COV_MAP_SIZE];
+    static uint8_t virgin[Emu16::COV_MAP_SIZE], virgin_crash[Emu16::COV_MAP_SIZE], virgin_hang[Emu16::COV_MAP_SIZE];
+    std::memset(virgin, 0xFF, sizeof(virgin));
+    std::memset(virgin_crash, 0xFF, sizeof(virgin_crash));
+    std::memset(virgin_hang, 0xFF, sizeof(virgin_hang));
+    init_count_class();
+    emu.cov_map = trace_bits;
+
+    size_t input_len = 0;
+    for(const Region& r : regions) input_len += r.len;
+
+    enum Outcome { OK, CRASH, HANG };
+    auto run_one = [&](const std::vector<uint16_t>& in) -> Outcome {
+        emu.restore(base);
+        std::memset(trace_bits, 0, sizeof(trace_bits));
+        size_t k = 0;
+        for(const Region& r : regions)
+            for(uint16_t j = 0; j < r.len; ++j)
+                emu.mem.poke(uint16_t(r.addr + j), in[k++]);
+        switch(emu.run_for(budget)){
+        case StopReason::Fault: return CRASH;
+        case StopReason::Halted: return OK;
+        default: return HANG;
+        }
+    };
+
+    std::error_code ec;
+    for(const char* sub : { "queue", "crashes", "hangs" })
+        fs::create_directories(fs::path(out_dir) / sub, ec);
+    if(ec){ std::cerr << "Failed to create " << out_dir << ": " << ec.message() << "\n"; return 1; }
+
+    // Seeds: whatever the image already holds in the regions, plus --in files.
+    std::vector<std::vector<uint16_t>> seeds;
+    {
+        std::vector<uint16_t> s;
+        for(const Region& r : regions)
+            for(uint16_t j = 0; j < r.len; ++j) s.push_back(base.mem[uint16_t(r.addr + j)]);
+        seeds.push_back(s);
+    }
+    if(!in_dir.empty()){
+        for(const auto& e : fs::directory_iterator(in_dir, ec)){
+            std::vector<uint16_t> s;
+            if(!e.is_regular_file() || !load_image(e.path().string(), s)) continue;
+            s.resize(input_len, 0);
+            seeds.push_back(s);
+        }
+    }
+
+    std::vector<std::vector<uint16_t>> queue;
+    uint64_t crashes = 0, hangs = 0;
+    auto triage = [&](const std::vector<uint16_t>& in, Outcome o){
+        if(o == CRASH){
+            if(has_new_bits(trace_bits, virgin_crash, sizeof(trace_bits)))
+                save_words(fs::path(out_dir) / "crashes" / ("id-" + std::to_string(crashes++) + ".bin"), in);
+        } else if(o == HANG){
+            if(has_new_bits(trace_bits, virgin_hang, sizeof(trace_bits)))
+                save_words(fs::path(out_dir) / "hangs" / ("id-" + std::to_string(hangs++) + ".bin"), in);
+        } else if(has_new_bits(trace_bits, virgin, sizeof(trace_bits))){
+            save_words(fs::path(out_dir) / "queue" / ("id-" + std::to_string(queue.size()) + ".bin"), in);
+            queue.push_back(in);
+        }
+    };
+    for(const auto& s : seeds) triage(s, run_one(s));
+    if(queue.empty()) queue.push_back(seeds.front());
+
+    Rng rng(seed);
+    using clock = std::chrono::steady_clock;
+    const auto t0 = clock::now();
+    auto last_report = t0;
+    uint64_t n = 0;
+    std::vector<uint16_t> cur;
+    for(size_t qi = 0; iters == 0 || n < iters; ++qi){
+        cur = queue[qi % queue.size()];
+        mutate(cur, queue, rng);
+        triage(cur, run_one(cur));
+        ++n;
+        if((n & 0x3FFF) == 0){
+            auto now = clock::now();
+            double el = std::chrono::duration<double>(now - t0).count();
+            if(std::chrono::duration<double>(now - last_report).count() >= 1.0){
+                last_report = now;
+                std::cerr << "[fuzz] iters=" << n << " exec/s=" << uint64_t(n / el)
+                          << " corpus=" << queue.size() << " edges=" << count_edges(virgin, sizeof(virgin))
+                          << " crashes=" << crashes << " hangs=" << hangs << "\n";
+            }
+            if(time_limit > 0 && el >= time_limit) break;
+        }
+    }
+    double el = std::chrono::duration<double>(clock::now() - t0).count();
+    std::cerr << "[fuzz] done: iters=" << n << " exec/s=" << uint64_t(el > 0 ? n / el : 0)
+              << " corpus=" << queue.size() << " edges=" << count_edges(virgin, sizeof(virgin))
+              << " crashes=" << crashes << " hangs=" << hangs << "\n";
+    return crashes ? 2 : 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * simpoint16 — sampled simulation: pick representative intervals, checkpoint
+ * them, and extrapolate a timing model's total cycles
+ * -----------------------------------------------------------------------------
+ * For each program: profile basic-block vectors per --interval instructions,
+ * cluster them (k by BIC up to --max-k, or fixed with --k), checkpoint the
+ * representative intervals, run --model only on those and extrapolate. Unless
+ * --no-full is given the model also runs the whole program, and the table
+ * shows the extrapolation error and the share of instructions simulated:
+ *
+ *     simpoint16 build/bench/fib24.bin build/bench/qsort.bin --interval 20000
+ *
+ * --checkpoints <dir> writes the checkpoints (one program only) and
+ * --simulate <dir> later runs a model from them without re-profiling.
+ * --max-insts / --max-cycles cut programs that never halt: the budget is
+ * then the end of the program for profiling, sampling and the full run.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../emulator/Emu16.cpp"
+#include "../emulator/Loader.cpp"
+#include "../emulator/SimPoint.cpp"
+
+namespace fs = std::filesystem;
+
+static void usage(const char* argv0){
+    std::cerr << "Usage: " << argv0 << " <program.bin>... [--interval <instructions>] [--max-k <n> | --k <n>] [--seed <n>]\n"
+              << "       [--max-insts <n>] [--max-cycles <n>] [--model <name>] [--no-full] [--checkpoints <dir>] [--verbose]\n"
+              << "       " << argv0 << " --simulate <dir> [--model <name>]\n"
+              << "       " << argv0 << " --list\n";
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point t0){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static std::unique_ptr<Emu16> fresh_core(const std::vector<uint16_t>& rom){
+    std::unique_ptr<Emu16> emu(new Emu16(false));
+    emu->mem.io.out = nullptr;
+    emu->load(rom, 0x0000);
+    emu->reset();
+    return emu;
+}
+
+static int simulate(const std::string& dir, const TimingModel& model){
+    std::ifstream list(dir + "/simpoints.txt");
+    if(!list){ std::cerr << "simpoint16: cannot read " << dir << "/simpoints.txt\n"; return 1; }
+    std::vector<SimPoints::Checkpoint> cps;
+    std::string file;
+    while(list >> file){
+        SimPoints::Checkpoint c;
+        if(!SimPoints::load(dir + "/" + file, c)){ std::cerr << "simpoint16: bad checkpoint " << file << "\n"; return 1; }
+        cps.push_back(std::move(c));
+    }
+    Emu16 emu(false);
+    emu.mem.io.out = nullptr;
+    uint64_t insts = 0, sim = 0;
+    for(const SimPoints::Checkpoint& c : cps){ insts += c.point.weight; sim += c.point.length; }
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t est = SimPoints::estimate(cps, model, emu);
+    std::cout << "model " << model.name << ": " << est << " cycles estimated for " << insts << " instructions from "
+              << cps.size() << " checkpoints (" << sim << " instructions simulated, " << std::fixed << std::setprecision(3)
+              << seconds_since(t0) << " s)\n";
+    return 0;
+}
+
+int main(int argc, char** argv){
+    std::vector<std::string> paths;
+    std::string model_name = "emu16", ckpt_dir, sim_dir;
+    uint64_t interval = 10000, seed = 1, max_insts = UINT64_MAX, max_cycles = UINT64_MAX;
+    unsigned max_k = 10, fixed_k = 0;
+    bool full = true, verbose = false;
+    for(int i=1;i<argc;i++){
+        std::string a = argv[i];
+        if(a == "--interval" && i+1 < argc) interval = std::strtoull(argv[++i], nullptr, 0);
+        else if(a == "--max-k" && i+1 < argc) max_k = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        else if(a == "--k" && i+1 < argc) fixed_k = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        else if(a == "--seed" && i+1 < argc) seed = std::strtoull(argv[++i], nullptr, 0);
+        else if(a == "--max-insts" && i+1 < argc) max_insts = std::strtoull(argv[++i], nullptr, 0);
+        else if(a == "--max-cycles" && i+1 < argc) max_cycles = std::strtoull(argv[++i], nullptr, 0);
+        else if(a == "--model" && i+1 < argc) model_name = argv[++i];
+        else if(a == "--checkpoints" && i+1 < argc) ckpt_dir = argv[++i];
+        else if(a == "--simulate" && i+1 < argc) sim_dir = argv[++i];
+        else if(a == "--no-full") full = false;
+        else if(a == "--verbose") verbose = true;
+        else if(a == "--list"){
+            for(const TimingModel& m : SimPoints::models()) std::cout << std::left << std::setw(10) << m.name << m.what << "\n";
+            return 0;
+        }
+        else if(a.size() && a[0] == '-'){ usage(argv[0]); return 1; }
+        else paths.push_back(a);
+    }
+    const TimingModel* model = SimPoints::find_model(model_name);
+    if(!model){ std::cerr << "simpoint16: unknown model " << model_name << " (see --list)\n"; return 1; }
+    if(!sim_dir.empty()) return simulate(sim_dir, *model);
+    if(paths.empty() || interval == 0 || max_insts == 0 || max_cycles == 0 || (!ckpt_dir.empty() && paths.size() != 1)){
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(14) << "program" << std::right << std::setw(12) << "insts" << std::setw(8) << "ivals"
+              << std::setw(4) << "k" << std::setw(9) << "sim%" << std::setw(14) << "estimated";
+    if(full) std::cout << std::setw(14) << "full" << std::setw(9) << "error" << std::setw(9) << "speedup";
+    std::cout << "\n";
+    double worst = 0;
+    for(const std::string& path : paths){
+        std::vector<uint16_t> rom;
+        if(!load_image(path, rom)){ std::cerr << "Failed to open " << path << "\n"; return 1; }
+
+        SimPoints sp;
+        sp.profile(*fresh_core(rom), interval, max_k, fixed_k, seed, max_insts, max_cycles);
+        if(sp.truncated)
+            std::cerr << "simpoint16: " << path << " stopped at the budget after " << sp.total_insts << " instructions\n";
+        std::vector<SimPoints::Checkpoint> cps = sp.checkpoints(*fresh_core(rom));
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t est = SimPoints::estimate(cps, *model, *fresh_core(rom));
+        double t_sampled = seconds_since(t0);
+
+        uint64_t simulated = 0;
+        for(const SimPoints::Point& p : sp.points) simulated += p.length;
+        std::cout << std::left << std::setw(14) << fs::path(path).stem().string() << std::right << std::setw(12) << sp.total_insts
+                  << std::setw(8) << sp.cluster.size() << std::setw(4) << sp.k << std::fixed << std::setprecision(2)
+                  << std::setw(8) << 100.0 * double(simulated) / double(sp.total_insts) << "%" << std::setw(14) << est;
+        if(full){
+            std::unique_ptr<Emu16> emu = fresh_core(rom);
+            t0 = std::chrono::steady_clock::now();
+            uint64_t truth = model->run(*emu, sp.total_insts);
+            double t_full = seconds_since(t0);
+            double err = truth ? 100.0 * (double(est) - double(truth)) / double(truth) : 0.0;
+            worst = std::max(worst, std::fabs(err));
+            std::cout << std::setw(14) << truth << std::setw(8) << std::showpos << err << std::noshowpos << "%"
+                      << std::setw(8) << std::setprecision(1) << (t_sampled > 0 ? t_full / t_sampled : 0.0) << "x";
+        }
+        std::cout << "\n";
+        if(verbose){
+            for(const SimPoints::Point& p : sp.points)
+                std::cout << "    interval " << std::setw(6) << p.interval << "  start " << std::setw(10) << p.start
+                          << "  weight " << std::setw(6) << std::setprecision(2) << 100.0 * double(p.weight) / double(sp.total_insts) << "%\n";
+        }
+        if(!ckpt_dir.empty()){
+            fs::create_directories(ckpt_dir);
+            std::ofstream list(ckpt_dir + "/simpoints.txt");
+            for(const SimPoints::Checkpoint& c : cps){
+                std::string file = "interval" + std::to_string(c.point.interval) + ".e16ckpt";
+                if(!SimPoints::save(ckpt_dir + "/" + file, c)){ std::cerr << "simpoint16: cannot write " << file << "\n"; return 1; }
+                list << file << "\n";
+            }
+            std::cout << cps.size() << " checkpoints written to " << ckpt_dir << "\n";
+        }
+    }
+    if(full && paths.size() > 1) std::cout << "worst |error| " << std::fixed << std::setprecision(2) << worst << "%\n";
+    return 0;
+}
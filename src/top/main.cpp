@@ -0,0 +1,92 @@
+/**
+ * emu16-top — live view of an emu16 --metrics-shm segment
+ * -----------------------------------------------------------------------------
+ * Redraws once per interval: run state, instructions and cycles with their
+ * rates over the last interval (MIPS, guest MHz), current PC (symbolized with
+ * --sym/--map), call depth and console bytes. Exits when the run ends or
+ * the emulator process goes away. --once prints a single snapshot.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "../emulator/Metrics.cpp"
+#include "../emulator/Symbols.cpp"
+
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+static void usage(const char* argv0){
+    std::cerr << "Usage: " << argv0 << " <name> [--interval <ms>] [--once] [--sym <file.sym> | --map <file.map>]\n";
+}
+
+static const char* state_name(MetricsPage::State s){
+    switch(s){
+    case MetricsPage::Running: return "running";
+    case MetricsPage::Halted: return "halted";
+    case MetricsPage::Fault: return "fault";
+    case MetricsPage::Budget: return "cycle limit";
+    }
+    return "?";
+}
+
+static bool alive(uint32_t pid){
+#ifndef _WIN32
+    return kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#else
+    (void)pid;
+    return true;
+#endif
+}
+
+int main(int argc, char** argv){
+    std::string name, sym_path;
+    unsigned interval_ms = 500;
+    bool once = false;
+    for(int i=1;i<argc;i++){
+        std::string a = argv[i];
+        if(a == "--interval" && i+1 < argc) interval_ms = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        else if(a == "--once") once = true;
+        else if((a == "--sym" || a == "--map") && i+1 < argc) sym_path = argv[++i];
+        else if(a.size() && a[0] == '-'){ usage(argv[0]); return 1; }
+        else name = a;
+    }
+    if(name.empty() || interval_ms == 0){ usage(argv[0]); return 1; }
+
+    Symbols sym;
+    if(!sym_path.empty() && !sym.load(sym_path)){ std::cerr << "Failed to read symbols from " << sym_path << "\n"; return 1; }
+    MetricsReader rd;
+    std::string err;
+    if(!rd.open(name, err)){ std::cerr << "emu16-top: " << err << "\n"; return 1; }
+
+    MetricsSample prev, cur;
+    bool have_prev = false;
+    for(;;){
+        if(!rd.read(cur)){ std::this_thread::sleep_for(std::chrono::milliseconds(1)); continue; }
+        double dt = have_prev && cur.updated_ns > prev.updated_ns ? double(cur.updated_ns - prev.updated_ns) / 1e9 : 0.0;
+        double mips = dt > 0 ? double(cur.instructions - prev.instructions) / dt / 1e6 : 0.0;
+        double mhz = dt > 0 ? double(cur.cycles - prev.cycles) / dt / 1e6 : 0.0;
+        double up = double(cur.updated_ns - cur.started_ns) / 1e9;
+        double age = double(metrics_now_ns() - cur.updated_ns) / 1e9;
+        if(!once) std::cout << "\033[H\033[2J";
+        std::cout << "emu16 pid " << cur.pid << "  " << cur.image << "  [" << state_name(cur.state) << "]\n"
+                  << std::fixed << std::setprecision(1)
+                  << "  elapsed        " << up << " s (updated " << age << " s ago)\n"
+                  << "  instructions   " << cur.instructions << "  (" << std::setprecision(2) << mips << " MIPS)\n"
+                  << "  cycles         " << cur.cycles << "  (" << mhz << " MHz guest)\n"
+                  << "  pc             " << Emu16::hex4(cur.pc);
+        if(!sym.empty()) std::cout << "  " << sym.format(cur.pc);
+        std::cout << "\n  call depth     " << cur.call_depth
+                  << "\n  console bytes  " << cur.console_bytes << "\n" << std::flush;
+        if(once || cur.state != MetricsPage::Running) return 0;
+        if(!alive(cur.pid)){ std::cout << "emu16 exited\n"; return 0; }
+        prev = cur;
+        have_prev = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+}
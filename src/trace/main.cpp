@@ -0,0 +1,121 @@
+/**
+ * trace16 — decoder for emu16 --trace-bin files
+ * -----------------------------------------------------------------------------
+ * Prints one line per recorded instruction:
+ *
+ *     cycle  PC  [label+off]  word  mnemonic  register changes  flags  store
+ *
+ * and can narrow the output to a PC range, a cycle window, instructions that
+ * wrote a given register, or stores to a given address. With --sym/--map the
+ * PC is symbolized the same way as in the emulator's profiler reports.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include "../emulator/BinaryTrace.cpp"
+#include "../emulator/Symbols.cpp"
+
+static void usage(const char* argv0){
+    std::cerr << "Usage: " << argv0 << " <trace.e16t> [--pc <lo>:<hi>] [--cycles <from>:<to>]\n"
+              << "       [--reg r<n>] [--store <addr>] [--sym <file.sym> | --map <file.map>]\n"
+              << "       [--limit <n>] [--summary]\n";
+}
+
+static const char* mnemonic(uint16_t opcode){
+    static const char* names[32] = {
+        "NOP", "MOV", "ADD", "SUB", "AND", "OR", "XOR", "NOT", "SHL", "SHR", "CMP", "PUSH", "POP", "LD", "ST", "LDI",
+        "JMP", "JZ", "JNZ", "JC", "JN", "CALL", "RET", "HALT", "LD", "ST", "LEA", "ADDI", "SUBI", "MUL", "CAS", "FADD" };
+    return names[opcode & 0x1F];
+}
+
+// Operands that live in the first word; absolute/immediate forms show "..."
+static std::string disasm(uint16_t w){
+    uint16_t op = (w >> 11) & 0x1F, rd = (w >> 8) & 7, rs = (w >> 5) & 7;
+    std::ostringstream o;
+    o << mnemonic(op);
+    switch(op){
+    case ISA::MOV: case ISA::ADD: case ISA::SUB: case ISA::AND: case ISA::OR: case ISA::XOR:
+    case ISA::SHL: case ISA::SHR: case ISA::CMP: case ISA::MUL:
+        o << " r" << rd << ", r" << rs; break;
+    case ISA::NOT_: case ISA::POP: o << " r" << rd; break;
+    case ISA::PUSH: o << " r" << rs; break;
+    case ISA::LD_ABS: o << " r" << rd << ", [...]"; break;
+    case ISA::ST_ABS: o << " r" << rs << ", [...]"; break;
+    case ISA::LDI: case ISA::LEA: case ISA::ADDI: case ISA::SUBI: o << " r" << rd << ", ..."; break;
+    case ISA::LD_IND: o << " r" << rd << ", [r" << rs << "]"; break;
+    case ISA::ST_IND: o << " r" << rs << ", [r" << rd << "]"; break;
+    case ISA::CAS: o << " r" << rd << ", r" << rs << ", [r" << ((w >> 2) & 7) << "]"; break;
+    case ISA::FADD: o << " r" << rd << ", [r" << rs << "]"; break;
+    case ISA::JMP: case ISA::JZ: case ISA::JNZ: case ISA::JC: case ISA::JN: case ISA::CALL: o << " ..."; break;
+    default: break;
+    }
+    return o.str();
+}
+
+int main(int argc, char** argv){
+    std::string path, sym_path;
+    TraceFilter filter;
+    int reg = -1;
+    int64_t store_addr = -1;
+    uint64_t limit = UINT64_MAX;
+    bool summary = false;
+    for(int i=1;i<argc;i++){
+        std::string a = argv[i];
+        if((a == "--pc" || a == "--cycles") && i+1 < argc){
+            uint64_t lo = 0, hi = (a == "--pc") ? 0xFFFF : UINT64_MAX;
+            if(!parse_trace_range(argv[++i], lo, hi) || (a == "--pc" && hi > 0xFFFF)){ usage(argv[0]); return 1; }
+            if(a == "--pc"){ filter.pc_lo = uint16_t(lo); filter.pc_hi = uint16_t(hi); }
+            else { filter.cycle_lo = lo; filter.cycle_hi = hi; }
+        }
+        else if(a == "--reg" && i+1 < argc){
+            std::string r = argv[++i];
+            if(r == "sp") reg = 7;
+            else if(r.size() == 2 && (r[0] == 'r' || r[0] == 'R') && r[1] >= '0' && r[1] <= '7') reg = r[1] - '0';
+            else { usage(argv[0]); return 1; }
+        }
+        else if(a == "--store" && i+1 < argc) store_addr = int64_t(std::strtoul(argv[++i], nullptr, 0) & 0xFFFF);
+        else if((a == "--sym" || a == "--map") && i+1 < argc) sym_path = argv[++i];
+        else if(a == "--limit" && i+1 < argc) limit = std::strtoull(argv[++i], nullptr, 0);
+        else if(a == "--summary") summary = true;
+        else if(a.size() && a[0] == '-'){ usage(argv[0]); return 1; }
+        else path = a;
+    }
+    if(path.empty()){ usage(argv[0]); return 1; }
+
+    Symbols sym;
+    if(!sym_path.empty() && !sym.load(sym_path)){ std::cerr << "Failed to read symbols from " << sym_path << "\n"; return 1; }
+    TraceReader rd;
+    if(!rd.open(path)){ std::cerr << path << ": not an emu16 binary trace\n"; return 1; }
+
+    uint64_t total = 0, shown = 0, stores = 0, first = 0, last = 0;
+    TraceRecord r;
+    while(rd.next(r)){
+        if(total++ == 0) first = r.cycles;
+        last = r.cycles;
+        stores += r.has_store;
+        if(summary || shown >= limit) continue;
+        if(!filter.match(r.pc, r.cycles)) continue;
+        if(reg >= 0 && !(r.reg_mask & (1u << reg))) continue;
+        if(store_addr >= 0 && !(r.has_store && r.store_addr == uint16_t(store_addr))) continue;
+        shown++;
+        std::cout << std::setw(12) << r.cycles << "  " << Emu16::hex4(r.pc) << "  ";
+        if(!sym.empty()) std::cout << std::left << std::setw(16) << sym.format(r.pc) << std::right << "  ";
+        std::cout << Emu16::hex4(r.inst) << "  " << std::left << std::setw(20) << disasm(r.inst) << std::right;
+        for(int i=0;i<8;i++)
+            if(r.reg_mask & (1u << i)) std::cout << " r" << i << "=" << Emu16::hex4(r.regs[i]);
+        std::cout << "  " << ((r.flags & 8) ? 'N' : '-') << ((r.flags & 4) ? 'Z' : '-')
+                  << ((r.flags & 2) ? 'C' : '-') << ((r.flags & 1) ? 'V' : '-');
+        if(r.has_store) std::cout << "  [" << Emu16::hex4(r.store_addr) << "]=" << Emu16::hex4(r.store_value);
+        std::cout << "\n";
+    }
+    if(summary){
+        std::cout << "records " << total << "\nstores " << stores << "\nfirst_cycle " << first
+                  << "\nlast_cycle " << last << "\nstart_pc " << Emu16::hex4(rd.header.PC) << "\nfinal_regs";
+        for(int i=0;i<8;i++) std::cout << " r" << i << "=" << Emu16::hex4(rd.R[i]);
+        std::cout << "\n";
+    }
+    return 0;
+}